@@ -13,9 +13,21 @@
  * 3. send_command() - for sending instructions to the LCD - IR
  * 4. send_nibble() - used in the initialization() to help with the function setting
  * 5. delay_ms() ,delay_us() - for adding delays throughout when needed
+ * 6. lcd_wait() - polls the busy flag on D7 with R/W high
+ *
+ * send_data() and send_command() wait for the busy flag instead of fixed
+ * delays, a character takes ~0.1 ms. Only lcd_init() uses timed delays, the
+ * busy flag cannot be read before the LCD is in 4 bit mode.
+ *
+ * The framebuffer keeps one character per cell and a dirty bit for every
+ * cell that differs from the LCD. lcd_task() sends the dirty cells in
+ * address order and sets the address only where the LCD's own increment
+ * does not get there.
  ******************************************************************************/
 
 #include "./LCD.h"
+#include "./clock.h"
+#include "./tick.h"
 
 
 /******************************************************************************
@@ -29,6 +41,23 @@
 #define D5 BIT1
 #define D6 BIT2
 #define D7 BIT3
+#define DATA (D4 | D5 | D6 | D7)
+
+// Busy flag polls before giving up, ~2 ms on every clock profile; the
+// slowest instruction (clear, home) needs 1.52 ms. One poll is four 1 us
+// delays plus ~30 cycles for the port accesses, enable() and the loop:
+// 58 polls at 1 MHz, 258 at 8 MHz, 340 at 16 MHz.
+#define LCD_POLL_CYCLES (4 * CLOCK_CYCLES_PER_US + 30)
+#define LCD_BUSY_POLLS  (2000UL * CLOCK_CYCLES_PER_US / LCD_POLL_CYCLES)
+
+#define LCD_CELLS       (LCD_ROWS * LCD_COLS)
+#define LCD_NO_ADDR     0xFF
+
+char lcd_frame[LCD_CELLS];          // row 1 first
+unsigned long lcd_dirty = 0;        // bit n: lcd_frame[n] not on the LCD
+unsigned char lcd_addr;             // DDRAM address counter, LCD_NO_ADDR
+unsigned char lcd_on = 0;           // display turned on by lcd_task()
+unsigned char lcd_last;             // tick of the last flush, low byte
 
 /******************************************************************************
  * LOCAL FUNCTION PROTOTYPES
@@ -41,9 +70,8 @@ void delay_us(unsigned int us)
 {
   while (us)
   {
-    // 1 for 1 MHz
-    // 16 cycles done in 1 us - 16MHz
-    __delay_cycles(1);
+    // 1 cycle per us at 1 MHz, 16 at 16 MHz
+    __delay_cycles(CLOCK_CYCLES_PER_US);
     us--;
   }
 }
@@ -52,68 +80,88 @@ void delay_ms(unsigned int ms)
 {
   while (ms)
   {
-     // 1000 for 1MHz
-     // 16000 cycles done in 1ms
-    __delay_cycles(1000);
+     // 1000 cycles per ms at 1MHz, 16000 at 16 MHz
+    __delay_cycles(CLOCK_CYCLES_PER_MS);
     ms--;
   }
 }
 
-// Generate the Pulse
+// Generate the Pulse, E high for at least 450 ns
 void enable(void)
 {
     E_HIGH;
-    delay_ms(10);
+    __delay_cycles(CLOCK_CYCLES_PER_US);
     E_LOW;
+    __delay_cycles(CLOCK_CYCLES_PER_US);
 }
 
-void send_data(unsigned char data)
+// Wait until the LCD has finished the last instruction. D7 carries the
+// busy flag during the first of the two nibble reads.
+void lcd_wait(void)
 {
-    unsigned char lower_nibble = 0x0F & (data);
-    unsigned char higher_nibble = 0x0F & (data >> 4);
-    delay_us(100);
+    unsigned int polls = LCD_BUSY_POLLS;
+    unsigned char busy;
 
-    // send higher nibble
-    P2OUT =  (higher_nibble);
-    P3OUT &= ~(RW);
-    P3OUT |= RS;
-    enable();
+    P2DIR &= ~DATA;
+    P3OUT &= ~RS;
+    P3OUT |= RW;
 
-    delay_ms(10);
-    // send lower nibble
-    P2OUT =  (lower_nibble);
-    P3OUT &= ~(RW);
-    P3OUT |= RS;
-    enable();
-    delay_ms(10);
+    do
+    {
+        E_HIGH;
+        __delay_cycles(CLOCK_CYCLES_PER_US);  // data valid after 360 ns
+        busy = P2IN & D7;
+        E_LOW;
+        __delay_cycles(CLOCK_CYCLES_PER_US);
+        enable();                             // address counter, unused
+    }
+    while (busy && --polls);
+
+    P3OUT &= ~RW;
+    P2DIR |= DATA;
 }
 
-void send_command(unsigned char cmd)
+// The LCD is blank and at address 0, so is the framebuffer
+void lcd_fbReset(void)
 {
-    unsigned char lower_nibble = 0x0F & (cmd);
-    unsigned char higher_nibble = 0x0F & (cmd >> 4);
-    delay_us(100);
+    unsigned char i;
 
-    // higher nibble
-    P2OUT = (higher_nibble);
-    P3OUT &= ~(RW | RS);
-    enable();
-    delay_ms(10);
+    for (i = 0; i < LCD_CELLS; i++)
+        lcd_frame[i] = ' ';
+    lcd_dirty = 0;
+    lcd_addr = 0;
+}
 
-    // lower nibble
-    P2OUT = (lower_nibble);
-    P3OUT &= ~(RW | RS);
+// One nibble to the data pins, the other P2 pins keep their state
+void write_nibble(unsigned char nibble)
+{
+    P2OUT = (P2OUT & ~DATA) | (nibble & DATA);
     enable();
-    delay_ms(10);
 }
 
+void send_data(unsigned char data)
+{
+    lcd_wait();
+
+    P3OUT |= RS;
+    write_nibble(data >> 4);
+    write_nibble(data);
+}
+
+void send_command(unsigned char cmd)
+{
+    lcd_wait();
 
+    P3OUT &= ~RS;
+    write_nibble(cmd >> 4);
+    write_nibble(cmd);
+}
+
+// Single nibble of the initialization, the busy flag is not valid yet
 void send_nibble(unsigned char cmd)
 {
-    P2OUT = cmd;
-    P3OUT &= ~( RW | RS);
-    enable();
-    delay_ms(10);
+    P3OUT &= ~(RW | RS);
+    write_nibble(cmd);
 }
 
 
@@ -122,20 +170,15 @@ void create_cgram(unsigned char *data, unsigned char location)
     // Set the address
 
     send_command(0x40+(location*8));
-    delay_us(50);
 
     // Write into the CGRAM
     int i;
     for (i=0; i<8; i++)
     {
         send_data(data[i]);
-        delay_us(50);
     }
 
     send_command(0x2);
-    delay_us(50);
-
-    delay_ms(1000);
 
     send_data(0x00);
 
@@ -150,7 +193,6 @@ void read_cgram(unsigned char location)
     P3OUT |= (RW | RS);
     unsigned char addr = 0x40+(location*8);
     send_command(addr);
-    delay_us(50);
 }
 
 /******************************************************************************
@@ -166,39 +208,29 @@ void lcd_init(void)
     delay_ms(50); // Power ON and wait for more than 40ms
     send_nibble(0x03);
 
-    delay_ms(10); // Wait 4.1 ms
+    delay_ms(5); // Wait 4.1 ms
     send_nibble(0x03);
 
     delay_us(150);  // Wait 100 us
     send_nibble(0x03);
 
-    delay_us(200);
+    delay_us(100);
     send_nibble(0x02);  // 4 bit mode 0010
 
-    delay_ms(200);
-    send_nibble(0x2);
-    delay_ms(10);
-    send_nibble(0x8);  // 4 bit mode with 2 lines 0010 1000
+    // From here on in 4 bit mode, the busy flag can be polled
+    delay_us(100);
+    send_command(0x28);  // 4 bit mode with 2 lines 0010 1000
+
+    send_command(0x0E); // display on, cursor on 0000 1110
 
-    delay_ms(20);
-    send_nibble(0x0);
-    delay_ms(20);
-    send_nibble(0xE); // display off 0000 1000
+    send_command(0x01); // display clear 0000 0001
 
-    delay_ms(20);
-    send_nibble(0x0);
-    delay_ms(20);
-    send_nibble(0x1); // display clear 0000 0001
+    send_command(0x06); // increment cursor 0000 0110
 
-    delay_ms(20);
-    send_nibble(0x0);
-    delay_ms(20);
-    send_nibble(0x06); // increment cursor 0000 0110
+    send_command(0x08); // display off 0000 1000
 
-    delay_ms(20);
-    send_nibble(0x0);
-    delay_ms(20);
-    send_nibble(0x08); // return home
+    lcd_fbReset();
+    lcd_on = 0;
 
 }
 
@@ -209,17 +241,9 @@ void lcd_enable(unsigned char on)
      * Enable the LCD display
      */
     if (on == 1)
-    {
-        delay_ms(20);
-        send_nibble(0x0);
-        delay_ms(20);
-        send_nibble(0xC);  //  0000 1100
-    }
+        send_command(0x0C);  //  0000 1100
     else
-        delay_ms(20);
-        send_nibble(0x0);
-        delay_ms(20);
-        send_nibble(0x8); //  0000 1000
+        send_command(0x08); //  0000 1000
 }
 
 void lcd_cursorSet(unsigned char x, unsigned char y)
@@ -229,6 +253,7 @@ void lcd_cursorSet(unsigned char x, unsigned char y)
      * sets the cursor to the specified x and y position
      */
     y--;
+    lcd_addr = LCD_NO_ADDR;     // framebuffer has to set it again
 
     switch (x)
     {
@@ -249,21 +274,9 @@ void lcd_cursorShow(unsigned char on)
      * Show the cursor
      */
     if (on == 1)
-    {
-
-        delay_ms(20);
-        send_nibble(0x0);
-        delay_ms(20);
-        send_nibble(0xE); ; //  0000 1110
-    }
+        send_command(0x0E); //  0000 1110
     else
-    {
-
-        delay_ms(20);
-        send_nibble(0x0);
-        delay_ms(20);
-        send_nibble(0xC);  //  0000 1100
-    }
+        send_command(0x0C);  //  0000 1100
 
 }
 
@@ -274,20 +287,9 @@ void lcd_cursorBlink(unsigned char on)
      * Make the cursor to blink
      */
     if (on == 1)
-    {
-        delay_ms(20);
-        send_nibble(0x0);
-        delay_ms(20);
-        send_nibble(0xF);  //  0000 1111
-    }
+        send_command(0x0F);  //  0000 1111
     else
-    {
-
-        delay_ms(20);
-        send_nibble(0x0);
-        delay_ms(20);
-        send_nibble(0xE);  //  0000 1110
-    }
+        send_command(0x0E);  //  0000 1110
 }
 
 void lcd_clear(void)
@@ -295,11 +297,8 @@ void lcd_clear(void)
     /**
      * Clear the display
      */
-    delay_ms(20);
-    send_nibble(0x0);
-    delay_ms(20);
-    send_nibble(0x1);  // 0000 0001
-    delay_ms(20);
+    send_command(0x01);  // 0000 0001
+    lcd_fbReset();
 }
 
 void lcd_putChar(char character)
@@ -339,3 +338,77 @@ void lcd_putNumber(int number)
     //lcd_putChar(c);
 
 }
+
+void lcd_fbPut(unsigned char row, unsigned char col, const char *text)
+{
+    unsigned char i, end;
+
+    if ((row < 1) || (row > LCD_ROWS) || (col < 1) || (col > LCD_COLS))
+        return;
+
+    i = (row - 1) * LCD_COLS + col - 1;
+    end = row * LCD_COLS;
+    for (; (i < end) && *text; i++, text++)
+    {
+        if (lcd_frame[i] != *text)
+        {
+            lcd_frame[i] = *text;
+            lcd_dirty |= 1UL << i;
+        }
+    }
+}
+
+void lcd_fbLine(unsigned char row, const char *text)
+{
+    char line[LCD_COLS + 1];
+    unsigned char i;
+
+    for (i = 0; (i < LCD_COLS) && text[i]; i++)
+        line[i] = text[i];
+    for (; i < LCD_COLS; i++)
+        line[i] = ' ';
+    line[LCD_COLS] = 0;
+
+    lcd_fbPut(row, 1, line);
+}
+
+void lcd_fbClear(void)
+{
+    lcd_fbLine(1, "");
+    lcd_fbLine(2, "");
+}
+
+void lcd_task(void)
+{
+    unsigned char cells = LCD_FLUSH_CELLS;
+    unsigned char i, addr, now;
+
+    if (lcd_dirty == 0)
+        return;
+    now = tick_now();
+    if ((unsigned char) (now - lcd_last) < LCD_FLUSH_TICKS)
+        return;
+    lcd_last = now;
+
+    if (!lcd_on)
+    {
+        send_command(0x0C);  //  display on, no cursor 0000 1100
+        lcd_on = 1;
+    }
+
+    for (i = 0; (i < LCD_CELLS) && cells; i++)
+    {
+        if (!(lcd_dirty & (1UL << i)))
+            continue;
+
+        // Row 2 starts at DDRAM address 0x40
+        addr = (i < LCD_COLS) ? i : 0x40 + i - LCD_COLS;
+        if (addr != lcd_addr)
+            send_command(0x80 | addr);
+        send_data(lcd_frame[i]);
+        lcd_addr = addr + 1;
+
+        lcd_dirty &= ~(1UL << i);
+        cells--;
+    }
+}
@@ -23,14 +23,18 @@
  * CONSTANTS
  *****************************************************************************/
 
+#define LCD_ROWS        2
+#define LCD_COLS        16
 
+// Framebuffer flush: at most LCD_FLUSH_CELLS changed cells every
+// LCD_FLUSH_TICKS ticks (tick.h), ~1 ms of LCD traffic per call at 1 MHz
+#define LCD_FLUSH_TICKS 1
+#define LCD_FLUSH_CELLS 8
 
 /******************************************************************************
  * VARIABLES
  *****************************************************************************/
 
-unsigned char *ptr;
-
 /******************************************************************************
  * FUNCTION PROTOTYPES
  *****************************************************************************/
@@ -80,4 +84,25 @@ void lcd_putText (char * text);
 // Note that this is a signed variable! (1 pt.)
 void lcd_putNumber (int number);
 
+/** Framebuffer */
+
+// The framebuffer holds what the LCD should show. Writes return at once,
+// lcd_task() moves the changed cells to the LCD later. lcd_init() and
+// lcd_clear() blank both; the other functions above bypass it and should
+// not be mixed with it.
+
+// Write <text> from <row> / <col> (1 based, as lcd_cursorSet()) on, cut at
+// the end of the row.
+void lcd_fbPut (unsigned char row, unsigned char col, const char * text);
+
+// Same as lcd_fbPut(), the rest of the row is blanked.
+void lcd_fbLine (unsigned char row, const char * text);
+
+// Blank the framebuffer
+void lcd_fbClear (void);
+
+// Call from the main loop: paced by the tick, sends up to LCD_FLUSH_CELLS
+// changed cells and turns the display on with the first of them.
+void lcd_task (void);
+
 #endif /* LIBS_LCD_H_ */
@@ -44,6 +44,19 @@ unsigned char adac_read(unsigned char *values)
     return 0;
 }
 
+unsigned char adac_readAsync(i2c_txn_t *txn, unsigned char *values)
+{
+    txn->addr = 0x48;
+    txn->flags = 0;
+    txn->wlen = 0;
+    txn->rlen = 5;
+    txn->rbuf = values;
+    txn->timeout = 0;
+    txn->done = 0;
+
+    return i2c_submit(txn) != I2C_PENDING;
+}
+
 unsigned char adac_write(unsigned char value)
 {
     unsigned char r[2] = { 0x44, value };
@@ -29,8 +29,6 @@
  * VARIABLES
  *****************************************************************************/
 
-int init ;
-
 /******************************************************************************
  * FUNCTION PROTOTYPES
  *****************************************************************************/
@@ -45,6 +43,10 @@ unsigned char adac_init(void);
 // (Important: always pass an array of size four (at least).) (1 pt.)
 unsigned char adac_read(unsigned char * values);
 
+// Same as adac_read(), but only queue the transfer on <txn> and return.
+// <values> must stay valid until i2c_status(txn) is no longer I2C_PENDING.
+unsigned char adac_readAsync(i2c_txn_t *txn, unsigned char * values);
+
 // Write a certain value to the DAC. (1 pt.)
 unsigned char adac_write(unsigned char value);
 
@@ -0,0 +1,116 @@
+/***************************************************************************//**
+ * @file    clock.h
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   Clock profile and the constants derived from it
+ *
+ * Select the profile with --define=CLOCK_PROFILE=16 (or 8, 1) in the
+ * project settings; 1 MHz is the default. MCLK and SMCLK both run from the
+ * calibrated DCO, so everything below is derived from CLOCK_HZ:
+ *
+ *  profile   UART              I2C       UCA0BR  UCBRS  UCB0BR  tick
+ *  1 MHz       9600 Baud    100 kHz      104      1      10     8192 us
+ *  8 MHz     115200 Baud    400 kHz       69      4      20     4096 us
+ *  16 MHz    115200 Baud    400 kHz      138      7      40     2048 us
+ *
+ * UART_BAUD and I2C_HZ can be overridden the same way.
+ ******************************************************************************/
+
+#ifndef LIBS_CLOCK_H_
+#define LIBS_CLOCK_H_
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+
+#include <msp430g2553.h>
+
+/******************************************************************************
+ * CONSTANTS
+ *****************************************************************************/
+
+#ifndef CLOCK_PROFILE
+#define CLOCK_PROFILE   1
+#endif
+
+#if CLOCK_PROFILE == 1
+#define CLOCK_CALBC1    CALBC1_1MHZ
+#define CLOCK_CALDCO    CALDCO_1MHZ
+#define CLOCK_BAUD      9600
+#define CLOCK_I2C_HZ    100000
+#define TICK_WDT        WDT_MDLY_8      // SMCLK / 8192
+#define TICK_US         8192
+#define US_TIMER_ID     ID_0            // ultrasonic timer: 1 count per us
+#define US_COUNTS_PER_US 1
+#elif CLOCK_PROFILE == 8
+#define CLOCK_CALBC1    CALBC1_8MHZ
+#define CLOCK_CALDCO    CALDCO_8MHZ
+#define CLOCK_BAUD      115200
+#define CLOCK_I2C_HZ    400000
+#define TICK_WDT        WDT_MDLY_32     // SMCLK / 32768
+#define TICK_US         4096
+#define US_TIMER_ID     ID_3
+#define US_COUNTS_PER_US 1
+#elif CLOCK_PROFILE == 16
+#define CLOCK_CALBC1    CALBC1_16MHZ
+#define CLOCK_CALDCO    CALDCO_16MHZ
+#define CLOCK_BAUD      115200
+#define CLOCK_I2C_HZ    400000
+#define TICK_WDT        WDT_MDLY_32
+#define TICK_US         2048
+#define US_TIMER_ID     ID_3
+#define US_COUNTS_PER_US 2
+#else
+#error "CLOCK_PROFILE must be 1, 8 or 16"
+#endif
+
+#define CLOCK_MHZ           CLOCK_PROFILE
+#define CLOCK_HZ            (CLOCK_MHZ * 1000000UL)
+#define CLOCK_CYCLES_PER_US CLOCK_MHZ
+#define CLOCK_CYCLES_PER_MS (CLOCK_MHZ * 1000UL)
+
+#ifndef UART_BAUD
+#define UART_BAUD       CLOCK_BAUD
+#endif
+#ifndef I2C_HZ
+#define I2C_HZ          CLOCK_I2C_HZ
+#endif
+
+// UART, low frequency mode: UCBRx = f / baud, UCBRSx = round(8 * fraction)
+#define UART_BR         (CLOCK_HZ / UART_BAUD)
+#define UART_BRS        ((CLOCK_HZ * 8 + UART_BAUD / 2) / UART_BAUD - UART_BR * 8)
+#define UART_BR0        (UART_BR & 0xFF)
+#define UART_BR1        (UART_BR >> 8)
+#define UART_MCTL       (UART_BRS << 1)
+
+// I2C: UCBRx = f_SMCLK / f_SCL
+#define I2C_BR          (CLOCK_HZ / I2C_HZ)
+#define I2C_BR0         (I2C_BR & 0xFF)
+#define I2C_BR1         (I2C_BR >> 8)
+
+// Flash timing generator from MCLK, 257 .. 476 kHz: divider FLASH_FN + 1
+#define FLASH_FN        (CLOCK_HZ / 350000)
+
+// Refresh timer (TA1, SMCLK / 8, 62500 counts) interrupts per 0.5 s
+#define REFRESH_POSTSCALE CLOCK_MHZ
+
+/******************************************************************************
+ * CHECKS
+ *****************************************************************************/
+
+#if UART_BR < 3 || UART_BRS > 7
+#error "UART_BAUD is out of range for this clock profile"
+#endif
+
+// Baud rate error of more than 2 % breaks the link
+#if (UART_BR * 8 + UART_BRS) * UART_BAUD * 50 > CLOCK_HZ * 8 * 51 || \
+    (UART_BR * 8 + UART_BRS) * UART_BAUD * 50 < CLOCK_HZ * 8 * 49
+#error "UART_BAUD cannot be reached within 2 % at this clock profile"
+#endif
+
+#if I2C_BR < 4 || I2C_HZ > 400000
+#error "I2C_HZ is out of range for this clock profile"
+#endif
+
+#endif /* LIBS_CLOCK_H_ */
@@ -0,0 +1,54 @@
+/***************************************************************************//**
+ * @file    flash.c
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   Information memory erase and write
+ *
+ * Here goes a detailed description if required.
+ ******************************************************************************/
+
+#include "./flash.h"
+
+/******************************************************************************
+ * FUNCTION IMPLEMENTATION
+ *****************************************************************************/
+
+void flash_erase(void *segment)
+{
+    unsigned short state = __get_interrupt_state();
+    __disable_interrupt();
+
+    FCTL2 = FWKEY + FSSEL_1 + FLASH_FN;       // MCLK / (FN + 1)
+    FCTL3 = FWKEY;                            // Unlock, LOCKA unchanged
+    FCTL1 = FWKEY + ERASE;
+    *(unsigned int *) segment = 0;            // Dummy write starts the erase
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY + LOCK;
+
+    __set_interrupt_state(state);
+}
+
+void flash_write(void *dst, const void *src, unsigned char length)
+{
+    unsigned char *to = dst;
+    const unsigned char *from = src;
+    unsigned short state = __get_interrupt_state();
+    __disable_interrupt();
+
+    FCTL2 = FWKEY + FSSEL_1 + FLASH_FN;
+    FCTL3 = FWKEY;
+    FCTL1 = FWKEY + WRT;
+    while (length--)
+        *to++ = *from++;
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY + LOCK;
+
+    __set_interrupt_state(state);
+}
+
+void flash_store(void *segment, const void *src, unsigned char length)
+{
+    flash_erase(segment);
+    flash_write(segment, src, length);
+}
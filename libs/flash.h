@@ -0,0 +1,46 @@
+/***************************************************************************//**
+ * @file    flash.h
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   Information memory header
+ *
+ * Segments B to D of the information memory (64 bytes each) keep settings
+ * across resets. Segment A holds the DCO calibration and is never touched.
+ * While the flash is erased or written the CPU stalls and interrupts are
+ * held off, ~13 ms for an erase.
+ ******************************************************************************/
+
+#ifndef LIBS_FLASH_H_
+#define LIBS_FLASH_H_
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+
+#include <msp430g2553.h>
+#include "./clock.h"
+
+/******************************************************************************
+ * CONSTANTS
+ *****************************************************************************/
+
+#define FLASH_INFO_B    ((void *) 0x1080)
+#define FLASH_INFO_C    ((void *) 0x1040)
+#define FLASH_INFO_D    ((void *) 0x1000)
+#define FLASH_SEGMENT   64
+
+/******************************************************************************
+ * FUNCTION PROTOTYPES
+ *****************************************************************************/
+
+// Erase the segment <segment> points into, all bytes read 0xFF then.
+void flash_erase(void *segment);
+
+// Write <length> bytes to erased flash at <dst>.
+void flash_write(void *dst, const void *src, unsigned char length);
+
+// Erase the segment at <segment> and write <length> bytes to its start.
+void flash_store(void *segment, const void *src, unsigned char length);
+
+#endif /* LIBS_FLASH_H_ */
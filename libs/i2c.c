@@ -4,29 +4,45 @@
  * @date    30th June 2023
  * @brief   Implementation of I2C using common ISRs
  *
- * Here goes a detailed description if required.
+ * Transactions are queued and run entirely from the USCI_B0 interrupts:
+ * i2c_submit() only puts a descriptor into the queue, the ISRs walk it
+ * through START, write bytes, repeated START, read bytes and STOP and then
+ * start the next one. i2c_write(), i2c_read() and i2c_write_read() are
+ * blocking wrappers on top.
  ******************************************************************************/
 
 #include "./i2c.h"
 #include "./interrupts.h"
+#include "./clock.h"
+#include "./ultrasonic.h"
 
 /******************************************************************************
  * VARIABLES
  *****************************************************************************/
 
-// 1 if all bytes have been sent, 0 if transmission is still ongoing.
-unsigned char transferFinished = 0;
-unsigned char nack = 0;
-int check;
-int counter;  // Counter flag for the increment purpose in the array used in ISR
+#define PHASE_WRITE 0
+#define PHASE_READ  1
+
+i2c_txn_t *queue[I2C_QUEUE_LEN];
+volatile unsigned char queueHead = 0;   // next free slot, moved by submit
+volatile unsigned char queueTail = 0;   // running transaction, moved by ISR
+i2c_txn_t *active = 0;                  // transaction on the bus
+unsigned int activeStarted;             // tick it went on the bus, low word
+unsigned char phase;
+unsigned char counter;  // Counter for the bytes of the active phase
+unsigned char i2c_ready = 0;    // USCI_B0 is set up, only the address changes
+unsigned char i2c_addr;         // slave for i2c_write() / i2c_read()
 
 /******************************************************************************
  * LOCAL FUNCTION PROTOTYPES
  *****************************************************************************/
 
 void free_bus(void);
-void i2c_RXISR(void);
-void i2c_TXISR(void);
+void i2c_start(i2c_txn_t *txn);
+void i2c_startRead(void);
+void i2c_finish(unsigned char status);
+void i2c_enable(void);
+void i2c_next(void);
 
 /******************************************************************************
  * LOCAL FUNCTION IMPLEMENTATION
@@ -40,71 +56,178 @@ void free_bus()
     for (i = 0; i < 8; i++)
     {
         P1OUT |= BIT6;
-        _delay_cycles(16 * 5);
+        _delay_cycles(5 * CLOCK_CYCLES_PER_US);
         P1OUT &= ~BIT6;
-        _delay_cycles(16 * 5);
+        _delay_cycles(5 * CLOCK_CYCLES_PER_US);
+
+    }
+}
+
+// Release USCI_B0 from reset and enable the interrupts used by the engine
+void i2c_enable(void)
+{
+    UCB0CTL1 &= ~UCSWRST;                    // Clear SW reset, resume operation
+
+    IFG2 &= ~(UCB0TXIFG | UCB0RXIFG);         // Clear Interrupt flags
+    UCB0STAT &= ~(UCNACKIFG | UCALIFG);
+
+    UCB0I2CIE |= UCNACKIE | UCALIE;           // Enable NACK and AL interrupt
+}
+
+// Put <txn> on the bus. Runs with interrupts disabled or inside the ISR.
+void i2c_start(i2c_txn_t *txn)
+{
+    // The STOP of the previous transaction has to be out first
+    while (UCB0CTL1 & UCTXSTP)
+        ;
+
+    active = txn;
+    activeStarted = tick_now();
 
+    UCB0I2CSA = txn->addr;
+
+    if (txn->wlen == 0)
+    {
+        i2c_startRead();
+        return;
     }
+
+    phase = PHASE_WRITE;
+    counter = 0;
+    IE2 &= ~UCB0RXIE;
+    IE2 |= UCB0TXIE;
+    UCB0CTL1 |= UCTR + UCTXSTT;               // I2C TX, start condition
+}
+
+void i2c_startRead(void)
+{
+    phase = PHASE_READ;
+    counter = 0;
+    IE2 &= ~UCB0TXIE;
+    IE2 |= UCB0RXIE;
+
+    UCB0CTL1 &= ~UCTR;                        // Clearing for Receiving
+    UCB0CTL1 |= UCTXSTT;                      // I2C start condition
+
+    if (active->rlen == 1)
+    {
+        // A single byte needs the STOP right after the address went out
+        while (UCB0CTL1 & UCTXSTT)
+            ;
+        UCB0CTL1 |= UCTXSTP;                  // I2C RX stop condition
+    }
+}
+
+// Start the oldest queued transaction if the bus is free. P3.3 (I2C
+// enable) is the ultrasonic clock during a measurement, the queue waits
+// until it is over.
+void i2c_next(void)
+{
+    if ((active == 0) && (queueHead != queueTail) && !us_busy())
+        i2c_start(queue[queueTail % I2C_QUEUE_LEN]);
+}
+
+// Complete the active transaction and start the next one in the queue
+void i2c_finish(unsigned char status)
+{
+    i2c_txn_t *txn = active;
+
+    IE2 &= ~(UCB0TXIE | UCB0RXIE);
+    active = 0;
+    queueTail++;
+
+    txn->status = status;
+    if (txn->done)
+        txn->done(txn);
+
+    // The callback may have submitted, and thereby started, a new one
+    i2c_next();
 }
 
 void i2c_RXISR(void)
 {
     if (UCB0STAT & UCNACKIFG)
     {
-        nack = 1;
+        UCB0CTL1 |= UCTXSTP;                  // Give up, release the bus
         UCB0STAT &= ~UCNACKIFG;
-        transferFinished = 1;
+        IFG2 &= ~UCB0TXIFG;
+        if (active)
+            i2c_finish(I2C_ERR_NACK);
+    }
+
+    if (UCB0STAT & UCALIFG)
+    {
+        // Losing arbitration leaves USCI_B0 in slave mode: take the master
+        // role back (UCB0CTL0 only changes in reset), which clears UCALIFG
+        UCB0CTL1 |= UCSWRST;
+        UCB0CTL0 |= UCMST;
+        i2c_enable();
+        if (active)
+            i2c_finish(I2C_ERR_ARBLOST);
     }
 }
 
 void i2c_TXISR(void)
 {
-    if (IFG2 & UCB0TXIFG)
-    {
-        if (TxByteCtr == 0)                            // Check TX byte length
-        {
-            //UCB0CTL1 |= UCTXSTP;
-            IFG2 &= ~UCB0TXIFG;
-            transferFinished = 1;
-        }
-        else
-        {
-            UCB0TXBUF = PTxData[counter];              // Load TX buffer
-            TxByteCtr--;
-            counter++;
-        }
+    i2c_txn_t *txn = active;
 
+    if (txn == 0)
+    {
+        IFG2 &= ~(UCB0TXIFG | UCB0RXIFG);
+        return;
     }
 
-    if (IFG2 & UCB0RXIFG)                              // Receive Interrupt flag
+    if ((IFG2 & UCB0TXIFG) && (phase == PHASE_WRITE))
     {
-        if (counter < RxByteCtr)
+        if (counter < txn->wlen)                   // Check TX byte length
         {
-            int rx_val = UCB0RXBUF;                     // Copy from RX buffer
-            PRxData[counter] = rx_val;
+            UCB0TXBUF = txn->wbuf[counter];        // Load TX buffer
             counter++;
-
-            if (counter == (RxByteCtr - 1)) // Send STOP signal before the last byte is received to make the slave not send further bytes
-                UCB0CTL1 |= UCTXSTP;
-
         }
-        if (counter == RxByteCtr)
-
+        else
         {
-            IFG2 &= ~UCB0RXIFG;
-            transferFinished = 1;
+            IFG2 &= ~UCB0TXIFG;
+            if (txn->rlen)
+            {
+                // Repeated START: the master keeps the bus and turns it
+                // around once the last byte is out
+                i2c_startRead();
+            }
+            else
+            {
+                if (!(txn->flags & I2C_NOSTOP))
+                    UCB0CTL1 |= UCTXSTP;
+                i2c_finish(I2C_OK);
+            }
         }
     }
+    else if ((IFG2 & UCB0RXIFG) && (phase == PHASE_READ))  // Receive Interrupt flag
+    {
+        txn->rbuf[counter] = UCB0RXBUF;            // Copy from RX buffer
+        counter++;
 
+        if (counter == txn->rlen)
+            i2c_finish(I2C_OK);
+        else if (counter == (txn->rlen - 1)) // Send STOP signal before the last byte is received to make the slave not send further bytes
+            UCB0CTL1 |= UCTXSTP;
+    }
 }
 
 /******************************************************************************
  * FUNCTION IMPLEMENTATION
  *****************************************************************************/
 
-// TODO: Implement these functions:
 void i2c_init(unsigned char addr)
 {
+    i2c_addr = addr;
+
+    // USCI_B0 keeps running once set up (the UART on USCI_A0 is not
+    // affected by it), so later calls only route the bus.
+    if (i2c_ready)
+    {
+        P3OUT |= BIT3;                         // Enable I2C line
+        return;
+    }
 
     P1DIR |= (BIT6 | BIT7);
     P1OUT &= ~(BIT6 | BIT7);
@@ -112,157 +235,143 @@ void i2c_init(unsigned char addr)
     free_bus();                                // Free bus at the start
 
     // Route to I2C bus
-//    P1DIR |= BIT3;                             // Make output pin
-//    P1OUT |= BIT3;                             // Enable I2C line
     P3DIR |= BIT3;                             // Make output pin
     P3OUT |= BIT3;                             // Enable I2C line
 
-    interrupts_mode_i2c(i2c_RXISR, i2c_TXISR);   // For choosing i2c ISRs
-
     UCB0CTL1 |= UCSWRST;                       // Enable SW reset
 
-    //UCBR = f_SMCLK / f_BitClock = 1 MHz / 100 kHz = 10
+    //UCBR = f_SMCLK / f_BitClock, e.g. 1 MHz / 100 kHz = 10
     UCB0CTL0 = UCMST + UCMODE_3 + UCSYNC;     // I2C Master, synchronous mode
     UCB0CTL1 = UCSSEL_2 + UCSWRST;            // Use SMCLK, keep SW reset
-//    UCB0BR0 = 160;                            // fSCL = SMCLK/12 = ~100kHz
-//    UCB0BR1 = 0;
-    UCB0BR0 = 10;                             // fSCL = SMCLK/12 = ~100kHz
-    UCB0BR1 = 0;
+    UCB0BR0 = I2C_BR0;                        // fSCL = I2C_HZ, see clock.h
+    UCB0BR1 = I2C_BR1;
 
     P1SEL |= (BIT6 | BIT7);                   // Assign I2C pins to USCI_B0
     P1SEL2 |= (BIT6 | BIT7);
 
-    UCB0I2CSA = addr;                   // Set slave address - 0100 1000 for ADC
-    IE2 |= UCB0TXIE | UCB0RXIE;
-
-    UCB0CTL1 &= ~UCSWRST;                    // Clear SW reset, resume operation
-
-    IFG2 &= ~(UCB0TXIFG | UCB0RXIFG);         // Clear Interrupt flags
-    UCB0STAT &= ~UCNACKIFG;
-
-    UCB0I2CIE |= UCNACKIE;                    // Enable NACK interrupt
+    i2c_enable();
 
+    i2c_ready = 1;
 }
 
-unsigned char i2c_write(unsigned char length, unsigned char *txData,
-                        unsigned char stop)
+unsigned char i2c_submit(i2c_txn_t *txn)
 {
-    // Before writing, you should always check if the last STOP-condition has already been sent.
-    while (UCB0CTL1 & UCTXSTP)
-        ;
+    unsigned short state = __get_interrupt_state();
+    __disable_interrupt();
 
-    unsigned char ret = 1;
-    transferFinished = 0;
-    TxByteCtr = length;
-    PTxData = txData;
-    counter = 0;
+    if ((unsigned char) (queueHead - queueTail) >= I2C_QUEUE_LEN)
+    {
+        __set_interrupt_state(state);
+        return I2C_ERR_FULL;
+    }
 
-    IE2 |= UCB0TXIE;
-    //IE2 &= ~UCB0RXIE;
+    txn->status = I2C_PENDING;
+    queue[queueHead % I2C_QUEUE_LEN] = txn;
+    queueHead++;
 
-    UCB0CTL1 |= UCTR + UCTXSTT;               // I2C TX, start condition
+    // Bus idle: start right away, otherwise i2c_finish() or
+    // i2c_service() picks it up in order
+    i2c_next();
 
-    while (!transferFinished)
-        ;
+    __set_interrupt_state(state);
+    return I2C_PENDING;
+}
+
+void i2c_service(void)
+{
+    unsigned short state = __get_interrupt_state();
+    __disable_interrupt();
+
+    if (active)
+    {
+        unsigned int limit = active->timeout ? active->timeout : I2C_TIMEOUT_TICKS;
 
-    if (stop != 0)     // if stop =1  condition given,  the STOP is transmittted
+        if ((unsigned int) tick_now() - activeStarted > limit)
+        {
+            // Missing or stuck slave: reset the module, which also
+            // releases SCL/SDA, and report the transaction as failed
+            UCB0CTL1 |= UCSWRST;
+            i2c_enable();
+            i2c_finish(I2C_ERR_TIMEOUT);
+        }
+    }
+    else
     {
-        UCB0CTL1 |= UCTXSTP;
+        // Held back by an ultrasonic measurement that is over now
+        i2c_next();
     }
 
-    if (!nack)  // if transmitted byte is not acknowledged by the slave return 1
-        ret = 0;
-    nack = 0;
+    __set_interrupt_state(state);
+}
 
-    return ret;
+unsigned char i2c_status(i2c_txn_t *txn)
+{
+    if (txn->status == I2C_PENDING)
+        i2c_service();
+    return txn->status;
 }
 
-void i2c_read(unsigned char length, unsigned char *rxData)
+unsigned char i2c_wait(i2c_txn_t *txn)
 {
-    // Before writing, you should always check if the last STOP-condition has already been sent.
-    while (UCB0CTL1 & UCTXSTP)
+    unsigned char status;
+
+    while ((status = i2c_status(txn)) == I2C_PENDING)
         ;
-    transferFinished = 0;
-    RxByteCtr = length;
+    return status;
+}
 
-    PRxData = rxData;
-    counter = 0;
+unsigned char i2c_busy(void)
+{
+    return active != 0;
+}
 
-    IE2 |= UCB0RXIE;
-    IE2 &= ~UCB0TXIE;
+unsigned char i2c_idle(void)
+{
+    return queueHead == queueTail;
+}
 
-    if (length == 1)
-    {
-        UCB0CTL1 &= ~UCTR;                   // Clearing for Receiving
-        UCB0CTL1 |= UCTXSTT;                 // I2C start condition
+unsigned char i2c_write(unsigned char length, unsigned char *txData,
+                        unsigned char stop)
+{
+    i2c_txn_t txn = { 0 };
 
-        while (UCB0CTL1 & UCTXSTT)
-            ;
-        UCB0CTL1 |= UCTXSTP;                 // I2C RX stop condition
-    }
-    else
-    {
-        UCB0CTL1 &= ~UCTR;
-        UCB0CTL1 |= UCTXSTT;
-        //__delay_cycles(160000);
-    }
-    while (!transferFinished)
-        // Waiting for the transfer to be finished
-        ;
+    txn.addr = i2c_addr;
+    txn.flags = stop ? 0 : I2C_NOSTOP;
+    txn.wlen = length;
+    txn.wbuf = txData;
+
+    if (i2c_submit(&txn) != I2C_PENDING)
+        return 1;
 
+    // if transmitted byte is not acknowledged by the slave return 1
+    return i2c_wait(&txn) != I2C_OK;
 }
 
-//#pragma vector = USCIAB0TX_VECTOR
-//__interrupt void USCIAB0TX_ISR(void)
-//{
-//
-//    if (IFG2 & UCB0TXIFG)                              // UDAC connected to BCKL
-//    {
-//        if (TxByteCtr == 0)                            // Check TX byte length
-//        {
-//            //UCB0CTL1 |= UCTXSTP;
-//            IFG2 &= ~UCB0TXIFG;
-//            transferFinished = 1;
-//        }
-//        else
-//        {
-//            UCB0TXBUF = PTxData[counter];              // Load TX buffer
-//            TxByteCtr--;
-//            counter++;
-//        }
-//
-//    }
-//
-//    if (IFG2 & UCB0RXIFG)                               // Receive Interrupt flag
-//    {
-//        if (counter < RxByteCtr)
-//        {
-//            int rx_val = UCB0RXBUF;                     // Copy from RX buffer
-//            PRxData[counter] = rx_val;
-//            counter++;
-//
-//            if (counter == (RxByteCtr - 1))             // Send STOP signal before the last byte is received to make the slave not send further bytes
-//                UCB0CTL1 |= UCTXSTP;
-//
-//        }
-//        if (counter == RxByteCtr)
-//
-//        {
-//            //IFG2 &= ~UCB0RXIFG;
-//            transferFinished = 1;
-//        }
-//    }
-//
-//}
-//
-//#pragma vector = USCIAB0RX_VECTOR
-//__interrupt
-//void USCIAB0RX_ISR(void)
-//{
-//    if (UCB0STAT & UCNACKIFG)
-//    {
-//        nack = 1;
-//        UCB0STAT &= ~UCNACKIFG;
-//        transferFinished = 1;
-//    }
-//}
+unsigned char i2c_write_read(unsigned char wlen, const unsigned char *txData,
+                             unsigned char rlen, unsigned char *rxData)
+{
+    i2c_txn_t txn = { 0 };
+
+    txn.addr = i2c_addr;
+    txn.wlen = wlen;
+    txn.wbuf = txData;
+    txn.rlen = rlen;
+    txn.rbuf = rxData;
+
+    if (i2c_submit(&txn) != I2C_PENDING)
+        return 1;
+
+    return i2c_wait(&txn) != I2C_OK;
+}
+
+void i2c_read(unsigned char length, unsigned char *rxData)
+{
+    i2c_txn_t txn = { 0 };
+
+    txn.addr = i2c_addr;
+    txn.rlen = length;
+    txn.rbuf = rxData;
+
+    if (i2c_submit(&txn) == I2C_PENDING)
+        i2c_wait(&txn);
+}
@@ -16,32 +16,85 @@
  *****************************************************************************/
 
 #include <msp430g2553.h>
+#include "./tick.h"
 
 /******************************************************************************
  * CONSTANTS
  *****************************************************************************/
 
+// Transaction status / error codes
+#define I2C_OK              0
+#define I2C_PENDING         1   // queued or on the bus
+#define I2C_ERR_NACK        2   // slave did not acknowledge
+#define I2C_ERR_TIMEOUT     3   // not finished within its timeout
+#define I2C_ERR_ARBLOST     4   // another master took the bus
+#define I2C_ERR_FULL        5   // queue full, transaction not accepted
 
+// Transaction flags
+#define I2C_NOSTOP          0x01    // keep the bus after a pure write
+
+#define I2C_QUEUE_LEN       4       // must be a power of two
+#define I2C_TIMEOUT_TICKS   (50000UL / TICK_US + 2)    // default, ~50 ms
 
 /******************************************************************************
  * VARIABLES
  *****************************************************************************/
-unsigned int RxByteCtr;
-unsigned char *PRxData;                     // Pointer to RX data
-
-unsigned int TxByteCtr;
-unsigned char *PTxData;                     // Pointer to RX data
 
+typedef struct i2c_txn i2c_txn_t;
 
+// Transaction descriptor. The caller owns it and must keep it alive until
+// the status is no longer I2C_PENDING. A transaction writes <wlen> bytes
+// from <wbuf>, then reads <rlen> bytes into <rbuf>; either part may be
+// empty. Between the two parts a repeated START is sent, so the slave sees
+// one transfer (e.g. register pointer write + register read).
+struct i2c_txn
+{
+    unsigned char addr;                 // 7-bit slave address
+    unsigned char flags;                // I2C_NOSTOP
+    unsigned char wlen;
+    unsigned char rlen;
+    const unsigned char *wbuf;
+    unsigned char *rbuf;
+    unsigned int timeout;               // in ticks, 0 = I2C_TIMEOUT_TICKS
+    void (*done)(i2c_txn_t *txn);       // called from the ISR, may be 0
+    volatile unsigned char status;      // I2C_PENDING until finished
+};
 
 /******************************************************************************
  * FUNCTION PROTOTYPES
  *****************************************************************************/
 
-// Initialize the I2C state machine. The speed should be 100 kBit/s.
-// <addr> is the 7-bit address of the slave (MSB shall always be 0, i.e. "right alignment"). (2 pts.)
+// Initialize the I2C state machine. The speed is I2C_HZ (clock.h).
+// <addr> is the 7-bit address of the slave (MSB shall always be 0, i.e.
+// "right alignment") used by i2c_write() and i2c_read().
 void i2c_init (unsigned char addr);
 
+// Put <txn> into the transaction queue. Returns I2C_PENDING if it was
+// accepted, I2C_ERR_FULL if not. Completion is signalled by txn->status
+// and, if set, the txn->done callback (interrupt context). While an
+// ultrasonic measurement runs (us_busy()) P3.3 is not the I2C enable and
+// the queue is held.
+unsigned char i2c_submit(i2c_txn_t *txn);
+
+// Status of <txn>, checking the running transaction for a timeout.
+unsigned char i2c_status(i2c_txn_t *txn);
+
+// Wait until <txn> is finished and return its status.
+unsigned char i2c_wait(i2c_txn_t *txn);
+
+// Abort the running transaction if it has timed out, or start the queue
+// after an ultrasonic measurement. Call this regularly when only callbacks
+// are used.
+void i2c_service(void);
+
+// Returns 1 while a transaction is on the bus.
+unsigned char i2c_busy(void);
+
+// Returns 1 if no transaction is queued or running.
+unsigned char i2c_idle(void);
+
+// Blocking helpers on the i2c_init() address:
+
 // Write a sequence of <length> characters from the pointer <txData>.
 // Return 0 if the sequence was acknowledged, 1 if not. Also stop transmitting further bytes upon a missing acknowledge.
 // Only send a stop condition if <stop> is not 0. (2 pts.)
@@ -50,4 +103,10 @@ unsigned char i2c_write(unsigned char length, unsigned char * txData, unsigned c
 // Returns the next <length> characters from the I2C interface. (2 pts.)
 void i2c_read(unsigned char length, unsigned char * rxData);
 
+// Write <wlen> characters from <txData>, then read <rlen> characters into
+// <rxData> after a repeated START, as one transaction. Return 0 on success,
+// 1 on a missing acknowledge or timeout.
+unsigned char i2c_write_read(unsigned char wlen, const unsigned char * txData,
+                             unsigned char rlen, unsigned char * rxData);
+
 #endif /* EXERCISE_LIBS_I2C_H_ */
@@ -14,48 +14,41 @@
 
 #include "./interrupts.h"
 #include "./uart.h"
-
-/******************************************************************************
- * VARIABLES
- *****************************************************************************/
-
-void (*forRX)(void);
-//void (*forRX_uart)(void);
-//void (*forRX_i2c)(void);
-void (*forTX)(void);
+#include "./mma.h"
 
 /******************************************************************************
  * FUNCTION IMPLEMEMTATION
  *****************************************************************************/
 
-void interrupts_mode_i2c(void (*receive)(void), void (*transmit)(void))
-{
-    forRX = receive;
-//    forRX_i2c = receive;
-    forTX = transmit;
-//    uart_flag = 0;
-}
-
-void interrupts_mode_uart(void (*receive)(void), void (*transmit)(void))
-{
-    forRX = receive;
-//    forRX_uart = receive;
-    forTX = transmit;
-}
-
+// UART receive and I2C state changes
 #pragma vector = USCIAB0RX_VECTOR
 __interrupt void USCIAB0RX_ISR(void)
 {
-//    if (uart_flag == 1)
-//        forRX_uart();
-//    else
-//        forRX_i2c();
+    if (IFG2 & IE2 & UCA0RXIFG)
+        uart_RXISR();
 
-    forRX();
+    if (UCB0STAT & UCB0I2CIE & (UCNACKIFG | UCALIFG | UCSTTIFG | UCSTPIFG))
+        i2c_RXISR();
 }
 
+// UART transmit and I2C data, only flags whose interrupt is enabled count
 #pragma vector = USCIAB0TX_VECTOR
 __interrupt void USCIAB0TX_ISR(void)
 {
-    forTX();
+    if (IFG2 & IE2 & UCA0TXIFG)
+        uart_TXISR();
+
+    if (IFG2 & IE2 & (UCB0TXIFG | UCB0RXIFG))
+        i2c_TXISR();
+}
+
+// Ultrasonic echo and MMA INT1
+#pragma vector = PORT1_VECTOR
+__interrupt void PORT1_ISR(void)
+{
+    if (P1IFG & P1IE & BIT0)
+        us_echoISR();
+
+    if (P1IFG & P1IE & MMA_INT_BIT)
+        mma_intISR();
 }
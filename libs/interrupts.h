@@ -33,8 +33,24 @@
  * FUNCTION PROTOTYPES
  *****************************************************************************/
 
-void interrupts_mode_i2c(void (*receive)(void), void (*transmit)(void));
-void interrupts_mode_uart(void (*receive)(void), void (*transmit)(void));
+// USCI_A0 (UART) and USCI_B0 (I2C) share two interrupt vectors. The
+// dispatcher calls the driver handlers below by flag source, so both
+// peripherals can be active at the same time. A handler only runs while
+// its driver has the interrupt enabled.
+
+// UCA0RXIFG and UCA0TXIFG, in uart.c
+void uart_RXISR(void);
+void uart_TXISR(void);
+
+// I2C state changes (NACK, arbitration lost, START, STOP) and
+// UCB0TXIFG / UCB0RXIFG, in i2c.c
+void i2c_RXISR(void);
+void i2c_TXISR(void);
+
+// Port 1 is shared the same way: P1.0 is the ultrasonic echo
+// (ultrasonic.c), MMA_INT_BIT the accelerometer INT1 (mma.c).
+void us_echoISR(void);
+void mma_intISR(void);
 
 
 #endif
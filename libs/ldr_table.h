@@ -0,0 +1,70 @@
+/***************************************************************************//**
+ * @file    ldr_table.h
+ *
+ * @brief   LDR illuminance table
+ *
+ * Generated by tools/gen_tables.py, do not edit.
+ ******************************************************************************/
+
+#ifndef LIBS_LDR_TABLE_H_
+#define LIBS_LDR_TABLE_H_
+
+// LDR 10000 Ohm at 10 lux / gamma 0.70 against 10000 Ohm, clamped to
+// 2000 lux. Segments start at ADC code X with Y lux and rise by SLOPE
+// per code, both with TABLE_SHIFT fraction bits. INDEX holds the
+// segment of every 1 << INDEX_SHIFT codes.
+
+// Curve and tolerance the table was generated for
+#define LDR_R10                10000.0
+#define LDR_GAMMA              0.7
+#define LDR_R_FIXED            10000.0
+#define LDR_LUX_MAX            2000
+#define LDR_TOLERANCE          0.01
+#define LDR_TOLERANCE_LUX      0.6
+
+#define LDR_TABLE_LEN 49
+#define LDR_TABLE_SHIFT 4
+#define LDR_INDEX_SHIFT 4
+
+const unsigned int LDR_TABLE_X[50] =
+{
+    0, 126, 223, 288, 337, 377, 410, 424,
+    431, 450, 457, 475, 497, 518, 567, 580,
+    592, 599, 609, 619, 637, 669, 679, 691,
+    718, 752, 767, 785, 798, 811, 832, 850,
+    867, 882, 897, 912, 925, 937, 948, 958,
+    966, 973, 979, 985, 990, 994, 998, 999,
+    1000, 1024
+};
+
+const int LDR_TABLE_Y[49] =
+{
+    0, 10, 26, 42, 58, 74, 90, 97,
+    101, 113, 118, 130, 147, 165, 218, 234,
+    251, 261, 277, 293, 326, 396, 421, 454,
+    541, 684, 763, 875, 970, 1080, 1300, 1542,
+    1838, 2174, 2612, 3201, 3895, 4772, 5886, 7309,
+    8896, 10801, 13030, 16125, 19759, 23764, 29323, 31057,
+    32000
+};
+
+const int LDR_TABLE_SLOPE[49] =
+{
+    0, 0, 0, 0, 0, 0, 0, 1,
+    1, 1, 1, 1, 1, 1, 1, 1,
+    1, 2, 2, 2, 2, 2, 3, 3,
+    4, 5, 6, 7, 8, 10, 13, 17,
+    22, 29, 39, 53, 73, 101, 142, 198,
+    272, 372, 516, 727, 1001, 1390, 1734, 943,
+    0
+};
+
+const unsigned char LDR_TABLE_INDEX[64] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 2, 2,
+    2, 2, 3, 3, 3, 3, 4, 4, 5, 5, 6, 8, 8, 10, 11, 11,
+    12, 13, 13, 13, 14, 16, 17, 19, 20, 20, 21, 22, 23, 24, 24, 25,
+    26, 26, 28, 29, 30, 30, 31, 32, 33, 35, 36, 37, 39, 41, 44, 48
+};
+
+#endif /* LIBS_LDR_TABLE_H_ */
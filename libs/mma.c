@@ -13,6 +13,7 @@
  ******************************************************************************/
 
 #include "./mma.h"
+#include "./interrupts.h"
 
 /******************************************************************************
  * VARIABLES
@@ -22,6 +23,21 @@
 #define XYZ_DATA_CFG (0x0E)
 #define CTRL_REG1 (0x2A)
 #define CTRL_REG2 (0x2B)
+#define STATUS (0x00)
+#define F_STATUS (0x00)
+#define SYSMOD (0x0B)
+#define INT_SOURCE (0x0C)
+#define PL_STATUS (0x10)
+#define PL_CFG (0x11)
+#define PL_COUNT (0x12)
+#define FF_MT_CFG (0x15)
+#define FF_MT_SRC (0x16)
+#define FF_MT_THS (0x17)
+#define FF_MT_COUNT (0x18)
+#define TRANSIENT_CFG (0x1D)
+#define TRANSIENT_SRC (0x1E)
+#define TRANSIENT_THS (0x1F)
+#define TRANSIENT_COUNT (0x20)
 #define F_SETUP (0x09)
 #define OUT_X_MSB (0x01)
 #define PULSE_CFG (0x21)
@@ -43,6 +59,26 @@
 #define DIV_8_8G            16
 #define GRAVITY    9.8
 
+// Polling limit for mode changes
+#define MODE_TIMEOUT_TICKS  (20000UL / TICK_US + 2)
+
+// Polling limit for the first sample after activation, per ODR (MMA_ODR_*).
+// The turn-on time is 2 / ODR + 1 ms, one more period is the margin:
+// ~1.9 s at 1.56 Hz.
+#define DATA_TICKS(period_us)  ((3 * (period_us) + 1000UL) / TICK_US + 2)
+const unsigned int DATA_TIMEOUT_TICKS[8] = {
+    DATA_TICKS(1250UL), DATA_TICKS(2500UL), DATA_TICKS(5000UL),
+    DATA_TICKS(10000UL), DATA_TICKS(20000UL), DATA_TICKS(80000UL),
+    DATA_TICKS(160000UL), DATA_TICKS(640000UL)
+};
+
+// mma_configBegin() could not switch to standby
+#define CONFIG_FAILED       0xFF
+
+// cm/s^2 per count of the left-aligned 16 bit output, in Q16, for 2g, 4g
+// and 8g: 980.665 / 16384 * 65536 for 2g, twice that for 4g and 8g
+const unsigned int ACC_SCALE_Q16[3] = { 3923, 7845, 15691 };
+
 // All the bit values
 #define RST (0x40)
 #define G2 (0x0)
@@ -54,9 +90,33 @@
 #define STANDBY (0xFE)
 #define ACTIVE (0x01)
 #define ST (0x80)
-
-
-
+#define LNOISE (0x04)
+#define MODS_MASK (0x03)
+#define DR_MASK (0x38)
+#define DR_SHIFT 3
+#define F_MODE_CIRC (0x40)
+#define F_MODE_MASK (0xC0)
+#define F_WMRK_MASK (0x3F)
+#define F_CNT_MASK (0x3F)
+#define SYSMOD_MASK (0x03)
+#define ZYXDR (0x08)
+#define INT_EN_DRDY (0x01)
+#define INT_CFG_DRDY (0x01)
+#define IPOL (0x02)
+#define ELE_FF_MT (0x80)
+#define OAE (0x40)
+#define ELE_TRANSIENT (0x10)
+#define DBCNTM (0x80)
+#define PL_EN (0x40)
+// Sources that are events, same bits in INT_SOURCE, CTRL_REG4 and CTRL_REG5
+#define INT_EVENTS (MMA_EVENT_MOTION | MMA_EVENT_TAP | MMA_EVENT_ORIENTATION \
+                    | MMA_EVENT_TRANSIENT)
+
+
+// Register shadows. Every register write goes through mma_write(), which
+// keeps these in sync, so they are the authoritative copy of the chip
+// configuration and the read path never has to ask the chip for it.
+// mma_resync() reloads them after a reset or a bus error.
 unsigned char CMD_CTRL_REG1 = 0x00;
 unsigned char CMD_CTRL_REG2 = 0x00;
 unsigned char CMD_XYZ_DATA_CFG = 0x00;
@@ -68,20 +128,66 @@ unsigned char CMD_PULSE_LTCY = 0x00;
 unsigned char CMD_PULSE_THSZ = 0x00;
 unsigned char CMD_PULSE_TMLT = 0x00;
 unsigned char CMD_PULSE_WIND = 0x00;
-
-
-unsigned char xyz_values_8bit[3] = { 0, 0, 0 };
+unsigned char CMD_F_SETUP = 0x00;
+unsigned char CMD_FF_MT_CFG = 0x00;
+unsigned char CMD_FF_MT_THS = 0x00;
+unsigned char CMD_FF_MT_COUNT = 0x00;
+unsigned char CMD_TRANSIENT_CFG = 0x00;
+unsigned char CMD_TRANSIENT_THS = 0x00;
+unsigned char CMD_TRANSIENT_COUNT = 0x00;
+unsigned char CMD_PL_CFG = 0x80;
+unsigned char CMD_PL_COUNT = 0x00;
+
+
+// Last mma_read(): 3 MSB/LSB pairs, or in 8 bit mode the 3 MSBs in front
 unsigned char xyz_values_14bit[6] = { 0, 0, 0, 0, 0, 0 };
-int set_standby = 0;
-int data_range = 0;
-int data_resolution = 0;
+unsigned char set_standby = 0;
+unsigned char data_range = 0;
+unsigned char data_resolution = 0;
+
+void mma_txnDone(i2c_txn_t *txn);
+
+// INT1 is served by one transaction that walks through the reads one after
+// the other: INT_SOURCE (only with events enabled), the sample if data is
+// ready, then the source register of every pending event. Its completion
+// stores the result and starts the next read. Counters only count up.
+unsigned char mma_reg[1];
+unsigned char mma_raw[6];                   // sample or register value
+i2c_txn_t mma_txn = { MMA8451_SLAVE_ADDRESS, 0, 1, 1, mma_reg, mma_raw,
+                      0, mma_txnDone };
+unsigned long mma_tick;                     // tick of the interrupt
+
+mma_sample_t drdy_ring[MMA_RING_LEN];
+volatile unsigned char drdy_head = 0;       // written by the ISR
+volatile unsigned char drdy_tail = 0;       // written by mma_getSample()
+volatile unsigned int drdy_overruns = 0;
+unsigned char drdy_pending = 0;             // sample still to be read
+
+mma_event_t evt_ring[MMA_EVENT_LEN];
+volatile unsigned char evt_head = 0;        // written by the ISR
+volatile unsigned char evt_tail = 0;        // written by mma_getEvent()
+volatile unsigned int evt_overruns = 0;
+unsigned char evt_pending = 0;              // sources still to be read
 
 /******************************************************************************
  * LOCAL FUNCTION PROTOTYPES
  *****************************************************************************/
 void mma_write(unsigned char a, unsigned char b);
-void set_standby_mode();
-void set_active_mode();
+unsigned char *mma_shadow(unsigned char a);
+void mma_decode(void);
+void mma_convert(const unsigned char *raw, mma_accel_t *acc);
+void mma_intArm(void);
+unsigned char mma_intAsserted(void);
+void mma_intKick(void);
+void mma_intRecheck(void);
+void mma_intNext(void);
+unsigned char mma_eventConfig(unsigned char event, unsigned char on);
+unsigned char set_standby_mode();
+unsigned char set_active_mode();
+unsigned char mma_waitMode(unsigned char active);
+unsigned char mma_waitData(void);
+unsigned char mma_configBegin(void);
+void mma_configEnd(unsigned char active);
 int get_range(int r);
 signed char mma_get8(unsigned char axis);
 int mma_get14(unsigned char axis);
@@ -90,40 +196,139 @@ double mma_getreal(unsigned char axis);
 /******************************************************************************
  * LOCAL FUNCTION IMPLEMENTATION
  *****************************************************************************/
+// Shadow variable of register <a>, 0 if the register is not shadowed
+unsigned char *mma_shadow(unsigned char a)
+{
+    switch (a)
+    {
+    case CTRL_REG1:     return &CMD_CTRL_REG1;
+    case CTRL_REG2:     return &CMD_CTRL_REG2;
+    case CTRL_REG3:     return &CMD_CTRL_REG3;
+    case CTRL_REG4:     return &CMD_CTRL_REG4;
+    case CTRL_REG5:     return &CMD_CTRL_REG5;
+    case XYZ_DATA_CFG:  return &CMD_XYZ_DATA_CFG;
+    case PULSE_CFG:     return &CMD_PULSE_CFG;
+    case PULSE_LTCY:    return &CMD_PULSE_LTCY;
+    case PULSE_THSZ:    return &CMD_PULSE_THSZ;
+    case PULSE_TMLT:    return &CMD_PULSE_TMLT;
+    case PULSE_WIND:    return &CMD_PULSE_WIND;
+    case F_SETUP:       return &CMD_F_SETUP;
+    case FF_MT_CFG:     return &CMD_FF_MT_CFG;
+    case FF_MT_THS:     return &CMD_FF_MT_THS;
+    case FF_MT_COUNT:   return &CMD_FF_MT_COUNT;
+    case TRANSIENT_CFG: return &CMD_TRANSIENT_CFG;
+    case TRANSIENT_THS: return &CMD_TRANSIENT_THS;
+    case TRANSIENT_COUNT: return &CMD_TRANSIENT_COUNT;
+    case PL_CFG:        return &CMD_PL_CFG;
+    case PL_COUNT:      return &CMD_PL_COUNT;
+    }
+    return 0;
+}
+
+// Derive range, resolution and mode from the shadows
+void mma_decode(void)
+{
+    switch (CMD_XYZ_DATA_CFG & (FS0 | FS1))
+    {
+    case 0:
+        data_range = 2;
+        break;
+    case FS0:
+        data_range = 4;
+        break;
+    default:
+        data_range = 8;
+        break;
+    }
+
+    data_resolution = (CMD_CTRL_REG1 & F_READ) ? 8 : 14;
+    set_standby = !(CMD_CTRL_REG1 & ACTIVE);
+}
+
 void mma_write(unsigned char a, unsigned char b)
 {
     unsigned char r[2] = { a, b };
+    unsigned char *shadow = mma_shadow(a);
+
+    if (shadow)
+        *shadow = b;
     i2c_write(2, r, 1);
 
 }
 
-void set_standby_mode()
+// Poll SYSMOD until the MMA is in standby (<active> 0) or awake
+unsigned char mma_waitMode(unsigned char active)
 {
+    unsigned long start = tick_now();
+    unsigned char r[1] = { SYSMOD };
+    unsigned char mode;
 
-    CMD_CTRL_REG1 &= ~ACTIVE;
-    unsigned char r[2] = {0};
-    r[0] = CTRL_REG1;
-    r[1] = CMD_CTRL_REG1;
-    i2c_write(2, r, 1);
-    //mma_write(CTRL_REG1,  CMD_CTRL_REG1);
+    do
+    {
+        if (!i2c_write_read(1, r, 1, &mode)
+                && (((mode & SYSMOD_MASK) != 0) == active))
+            return 0;
+    }
+    while (tick_now() - start <= MODE_TIMEOUT_TICKS);
 
-    __delay_cycles(10000);
-    set_standby = 1;
+    return 1;
 }
 
-void set_active_mode()
+// Poll STATUS until a new sample is there (F_STATUS count with the FIFO on),
+// for as long as the first one takes at the configured ODR
+unsigned char mma_waitData(void)
 {
+    unsigned long start = tick_now();
+    unsigned int timeout =
+            DATA_TIMEOUT_TICKS[(CMD_CTRL_REG1 & DR_MASK) >> DR_SHIFT];
+    unsigned char r[1] = { STATUS };
+    unsigned char ready = (CMD_F_SETUP & F_MODE_MASK) ? F_CNT_MASK : ZYXDR;
+    unsigned char status;
 
-    CMD_CTRL_REG1 |= ACTIVE;
-    unsigned char r[2] = {0};
-    r[0] = CTRL_REG1;
-    r[1] = CMD_CTRL_REG1;
-    i2c_write(2, r, 1);
-    //mma_write(CTRL_REG1, CMD_CTRL_REG1);
+    do
+    {
+        if (!i2c_write_read(1, r, 1, &status) && (status & ready))
+            return 0;
+    }
+    while (tick_now() - start <= timeout);
+
+    return 1;
+}
+
+// Open a configuration window: go to standby unless already there.
+// Returns whether the MMA was active, for mma_configEnd(), or
+// CONFIG_FAILED if it did not get to standby.
+unsigned char mma_configBegin(void)
+{
+    unsigned char active = !set_standby;
+
+    if (active && set_standby_mode())
+        return CONFIG_FAILED;
+    return active;
+}
+
+void mma_configEnd(unsigned char active)
+{
+    if (active)
+        set_active_mode();
+}
+
+unsigned char set_standby_mode()
+{
+
+    mma_write(CTRL_REG1, CMD_CTRL_REG1 & ~ACTIVE);
+
+    set_standby = 1;
+    return mma_waitMode(0);
+}
 
-    __delay_cycles(1000000);
+unsigned char set_active_mode()
+{
+
+    mma_write(CTRL_REG1, CMD_CTRL_REG1 | ACTIVE);
 
     set_standby = 0;
+    return mma_waitMode(1);
 }
 
 int get_range(int r)
@@ -192,19 +397,13 @@ signed char mma_get8(unsigned char axis)
         b = 2;
     }
 
-    unsigned char rx[1] = { 0 };
-    unsigned char r[1] = { CTRL_REG1 };
-
-    i2c_write(1, r, 0);
-    i2c_read(1,rx);
-
-    if (!(rx[0] & F_READ ) )  //data_resolution == 14
+    if (!(CMD_CTRL_REG1 & F_READ ) )  //data_resolution == 14
     {
         value = xyz_values_14bit[a];
     }
-    if (rx[0] & F_READ )
+    if (CMD_CTRL_REG1 & F_READ )
     {
-        value = xyz_values_8bit[b];
+        value = xyz_values_14bit[b];
     }
 
     if ((value >> 7)!= 0) //((value / 8192) == 1)
@@ -243,21 +442,14 @@ int mma_get14(unsigned char axis)
         c = 2;
     }
 
-    unsigned char rx[1] = { 0 };
-    unsigned char r[1] = { CTRL_REG1 };
-
-    i2c_write(1, r, 0);
-    i2c_read(1,rx);
-
-
-    if (!(rx[0] & F_READ ) )  // data_resolution == 14
+    if (!(CMD_CTRL_REG1 & F_READ ) )  // data_resolution == 14
     {
         msb = xyz_values_14bit[a];
         lsb = xyz_values_14bit[b];
     }
-    if (rx[0] & F_READ )  // data_resolution == 8
+    if (CMD_CTRL_REG1 & F_READ )  // data_resolution == 8
     {
-        msb = xyz_values_8bit[c];
+        msb = xyz_values_14bit[c];
         lsb = 0x0;
     }
 
@@ -279,13 +471,7 @@ double mma_getreal(unsigned char axis)
     double real;
     int curr_range;
 
-    unsigned char rx[1] = { 0 };
-    unsigned char r[1] = { CTRL_REG1 };
-
-    i2c_write(1, r, 0);
-    i2c_read(1,rx);
-
-    if (rx[0] & F_READ )
+    if (CMD_CTRL_REG1 & F_READ )
     {
         if (axis == 'x')
             real = mma_get8X();
@@ -297,7 +483,7 @@ double mma_getreal(unsigned char axis)
         curr_range = get_range(8);
     }
 
-    if (!(rx[0] & F_READ ) )
+    if (!(CMD_CTRL_REG1 & F_READ ) )
     {
         if (axis == 'x')
             real = mma_get14X();
@@ -328,7 +514,10 @@ unsigned char mma_setRange(unsigned char range)
     // Make changes in XYZ_DATA_CFG - address - 0x0E
     // Value to the register -> FS1 FS0
 
-    set_standby_mode();
+    unsigned char active = mma_configBegin();
+
+    if (active == CONFIG_FAILED)
+        return 1;
 
     if (range == 0)
     {
@@ -352,7 +541,7 @@ unsigned char mma_setRange(unsigned char range)
 
     mma_write(XYZ_DATA_CFG, CMD_XYZ_DATA_CFG);
 
-    //set_active_mode();
+    mma_configEnd(active);
 
     return 0;
 }
@@ -360,11 +549,13 @@ unsigned char mma_setRange(unsigned char range)
 unsigned char mma_setResolution(unsigned char resolution)
 // measurement range. (0: 8bit, >=1: 14bit)
 {
-    unsigned char value;
     // Make changes in CTRL_REG1 - address - 0x2A
     // Value to the register -> F_READ bit
 
-    set_standby_mode();
+    unsigned char active = mma_configBegin();
+
+    if (active == CONFIG_FAILED)
+        return 1;
 
     // F_READ bit = 1
     if (resolution == 0)
@@ -382,8 +573,7 @@ unsigned char mma_setResolution(unsigned char resolution)
 
     mma_write( CTRL_REG1, CMD_CTRL_REG1);
 
-
-    //set_active_mode();
+    mma_configEnd(active);
 
     return 0;
 }
@@ -391,26 +581,32 @@ unsigned char mma_setResolution(unsigned char resolution)
 unsigned char mma_init(void)
 {
     unsigned char addr = 0x1D;
+    unsigned char r[1] = { CTRL_REG2 };
+    unsigned char rx[1] = { 0 };
+    unsigned char error;
+    unsigned long start;
     i2c_init(addr);
 
+    // The shadow may be stale after an MSP reset, so always write
     set_standby_mode();
 
     CMD_CTRL_REG2 |= RST;
     mma_write(CTRL_REG2, CMD_CTRL_REG2);
-    __delay_cycles(10000);
 
-    unsigned char rx[1] = { 0 };
-    unsigned char r[1] = { CTRL_REG2 };
-    _delay_cycles(16000);
-
-    // Wait for the RST bit to clear
+    // Wait for the RST bit to clear. The MMA does not answer while it
+    // boots, which counts as "not done yet".
+    start = tick_now();
     do
     {
-        i2c_write(1, r, 0);
-        i2c_read(1,rx);
-        rx[0] &= RST;
+        error = i2c_write_read(1, r, 1, rx);
     }
-    while (rx[0]);
+    while ((error || (rx[0] & RST))
+            && (tick_now() - start <= MODE_TIMEOUT_TICKS));
+
+    // The reset brought every register back to its default; without them
+    // the shadows would not match the chip
+    if (mma_resync())
+        return 1;
 
     // Set resolution to 8 Bit - 0
     mma_setResolution(0);
@@ -418,45 +614,146 @@ unsigned char mma_init(void)
     // Set range to 4g
     mma_setRange(1);
 
-    //set_active_mode();
+    return 0;
+}
+
+unsigned char mma_sessionOpen(mma_session_t *session)
+{
+    session->state = MMA_SESSION_CLOSED;
+
+    // All of it in the standby window mma_init() leaves open
+    if (mma_init())
+        return 1;
+    mma_setResolution(session->resolution);
+    mma_setRange(session->range);
+    if (session->range > 1)
+        session->lnoise = 0;            // low noise stops at 4g
+    mma_configure(session->odr, session->mods, session->lnoise);
+    if (set_active_mode() || mma_waitData())
+        return 1;
+
+    // Check that the configuration made it to the chip
+    if (mma_resync() || !(CMD_CTRL_REG1 & ACTIVE))
+        return 1;
+
+    session->state = MMA_SESSION_ACTIVE;
+    return 0;
+}
+
+unsigned char mma_sample(mma_session_t *session, mma_accel_t *acc)
+{
+    if ((session->state != MMA_SESSION_ACTIVE) && mma_sessionOpen(session))
+    {
+        session->errors++;
+        return 1;
+    }
+
+    if (mma_readAccel(acc))
+    {
+        session->state = MMA_SESSION_CLOSED;
+        session->errors++;
+        return 1;
+    }
 
     return 0;
 }
 
+unsigned char mma_resync(void)
+{
+    unsigned char r[1];
+    unsigned char ctrl[5];      // CTRL_REG1 .. CTRL_REG5
+    unsigned char pulse[4];     // PULSE_THSZ .. PULSE_WIND
+    unsigned char ff[2];        // FF_MT_THS, FF_MT_COUNT
+    unsigned char tr[2];        // TRANSIENT_THS, TRANSIENT_COUNT
+    unsigned char pl[2];        // PL_CFG, PL_COUNT
+    unsigned char xyz, pulse_cfg, f_setup, ff_cfg, tr_cfg;
+    unsigned char error = 0;
+
+    r[0] = CTRL_REG1;
+    error |= i2c_write_read(1, r, 5, ctrl);
+    r[0] = XYZ_DATA_CFG;
+    error |= i2c_write_read(1, r, 1, &xyz);
+    r[0] = PULSE_CFG;
+    error |= i2c_write_read(1, r, 1, &pulse_cfg);
+    // PULSE_SRC sits in between and is left out, reading it clears it
+    r[0] = PULSE_THSZ;
+    error |= i2c_write_read(1, r, 4, pulse);
+    r[0] = F_SETUP;
+    error |= i2c_write_read(1, r, 1, &f_setup);
+    // The *_SRC registers are left out here as well
+    r[0] = FF_MT_CFG;
+    error |= i2c_write_read(1, r, 1, &ff_cfg);
+    r[0] = FF_MT_THS;
+    error |= i2c_write_read(1, r, 2, ff);
+    r[0] = TRANSIENT_CFG;
+    error |= i2c_write_read(1, r, 1, &tr_cfg);
+    r[0] = TRANSIENT_THS;
+    error |= i2c_write_read(1, r, 2, tr);
+    r[0] = PL_CFG;
+    error |= i2c_write_read(1, r, 2, pl);
+
+    // A read that failed left its buffer undefined, the shadows only take
+    // a complete set
+    if (error)
+        return error;
+
+    CMD_CTRL_REG1 = ctrl[0];
+    CMD_CTRL_REG2 = ctrl[1];
+    CMD_CTRL_REG3 = ctrl[2];
+    CMD_CTRL_REG4 = ctrl[3];
+    CMD_CTRL_REG5 = ctrl[4];
+    CMD_XYZ_DATA_CFG = xyz;
+    CMD_PULSE_CFG = pulse_cfg;
+    CMD_PULSE_THSZ = pulse[0];
+    CMD_PULSE_TMLT = pulse[1];
+    CMD_PULSE_LTCY = pulse[2];
+    CMD_PULSE_WIND = pulse[3];
+    CMD_F_SETUP = f_setup;
+    CMD_FF_MT_CFG = ff_cfg;
+    CMD_FF_MT_THS = ff[0];
+    CMD_FF_MT_COUNT = ff[1];
+    CMD_TRANSIENT_CFG = tr_cfg;
+    CMD_TRANSIENT_THS = tr[0];
+    CMD_TRANSIENT_COUNT = tr[1];
+    CMD_PL_CFG = pl[0];
+    CMD_PL_COUNT = pl[1];
+
+    mma_decode();
+    return 0;
+}
+
 unsigned char mma_selftest(void)
 {
     int xbef,ybef ,zbef ,yaft ,zaft ;
     int diff_x , diff_y , diff_z ;
     char result, xaft;
+    // The test runs at 800 Hz, 4g, 14 bit; everything else is put back
+    unsigned char reg1 = CMD_CTRL_REG1;
+    unsigned char reg2 = CMD_CTRL_REG2;
+    unsigned char xyz = CMD_XYZ_DATA_CFG;
 
     CMD_CTRL_REG2 = 0x00;
     CMD_CTRL_REG1 = 0x00;
     set_standby_mode();
 
-    // Set range to 4g
+    // Set range to 4g, 14 bit, all in one standby window
     mma_setResolution(1);
     mma_setRange(1);
 
     CMD_CTRL_REG2 &= ~ST;
     mma_write(CTRL_REG2,  CMD_CTRL_REG2);
-    __delay_cycles(10000);
 
     set_active_mode();
+    mma_waitData();
     mma_read();
 
-    unsigned char rx[1] = { 0 };
-    unsigned char r[1] = { CTRL_REG1 };
-
-    i2c_write(1, r, 0);
-    i2c_read(1,rx);
-
-    if  (rx[0] & F_READ )
+    if  (CMD_CTRL_REG1 & F_READ )
     {
         xbef = mma_get8X();
         ybef = mma_get8Y();
         zbef = mma_get8Z();
     }
-    if  (!(rx[0] & F_READ ) )
+    if  (!(CMD_CTRL_REG1 & F_READ ) )
     {
         xbef = mma_get14X();
         ybef = mma_get14Y();
@@ -468,23 +765,22 @@ unsigned char mma_selftest(void)
 
     CMD_CTRL_REG2 |= ST;
     mma_write(CTRL_REG2, CMD_CTRL_REG2);
-    __delay_cycles(10000);
-
-    i2c_write(1, r, 0);
-    i2c_read(1,rx);
 
+    // The first sample after activation may still be settling, use the
+    // second one
     set_active_mode();
+    mma_waitData();
+    mma_read();
+    mma_waitData();
     mma_read();
 
-    __delay_cycles(10000);
-
-    if (rx[0] & F_READ )
+    if (CMD_CTRL_REG1 & F_READ )
     {
         xaft = mma_get8X();
         yaft = mma_get8Y();
         zaft = mma_get8Z();
     }
-    if (!(rx[0] & F_READ ) )
+    if (!(CMD_CTRL_REG1 & F_READ ) )
     {
         xaft = mma_get14X();
         yaft = mma_get14Y();
@@ -502,16 +798,26 @@ unsigned char mma_selftest(void)
     else
         result = 1;
 
-    // Self test disabled
+    // Self test disabled, back to the configuration from before
     set_standby_mode();
+    mma_write(CTRL_REG2, reg2 & ~(ST | RST));
+    mma_write(XYZ_DATA_CFG, xyz);
+    mma_write(CTRL_REG1, reg1 & ~ACTIVE);
+    mma_decode();
+    if (reg1 & ACTIVE)
+        set_active_mode();
 
     return result;
 }
 
 unsigned char mma_enableTapInterrupt(void)
 {
+    unsigned char active;
 
-    set_standby_mode();
+    i2c_init(MMA8451_SLAVE_ADDRESS);
+    active = mma_configBegin();
+    if (active == CONFIG_FAILED)
+        return 1;
     // Pulse config - ODR at 800Hz, 0110 0000  - ZDPEFE or may be 0010 0000 - 32 for without latch enabled
     mma_write(PULSE_CFG, 0x20);
 
@@ -527,49 +833,522 @@ unsigned char mma_enableTapInterrupt(void)
     // Pulse window at 800 Hz, without LP and in normal mode - 90ms is 72 counts for 1.25 ms per step per count
     mma_write(PULSE_WIND, 0x48);
 
-    // Enabling the bit INT_EN_PULSE for Interrupt
-    mma_write(CTRL_REG4, 0x8);
+    // INT_EN_PULSE, routed to INT1 (INT_CFG_PULSE)
+    mma_eventConfig(MMA_EVENT_TAP, 1);
+
+    // Interrupt polarity active high, the other bits stay. An armed pin
+    // has to wait for the other edge now.
+    mma_write(CTRL_REG3, CMD_CTRL_REG3 | IPOL);
+    if (mma_intInUse())
+        mma_intArm();
+
+    mma_configEnd(active);
+    return 0;
+
+}
+
+unsigned char mma_disableTapInterrupt(void)
+{
+    return mma_eventsDisable(MMA_EVENT_TAP);
+}
+
+unsigned char mma_readAccel(mma_accel_t *acc)
+{
+    i2c_init(MMA8451_SLAVE_ADDRESS);
+    if (mma_read())
+        return 1;
+
+    // One burst, so all axes belong to the same sample
+    mma_convert(xyz_values_14bit, acc);
+
+    return 0;
+}
+
+unsigned char mma_setDataRate(unsigned char rate)
+{
+    return mma_configure(rate, CMD_CTRL_REG2 & MODS_MASK,
+                         (CMD_CTRL_REG1 & LNOISE) != 0);
+}
+
+unsigned char mma_setOversampling(unsigned char mods)
+{
+    return mma_configure((CMD_CTRL_REG1 & DR_MASK) >> DR_SHIFT, mods,
+                         (CMD_CTRL_REG1 & LNOISE) != 0);
+}
+
+unsigned char mma_setLowNoise(unsigned char on)
+{
+    return mma_configure((CMD_CTRL_REG1 & DR_MASK) >> DR_SHIFT,
+                         CMD_CTRL_REG2 & MODS_MASK, on);
+}
+
+unsigned char mma_configure(unsigned char odr, unsigned char mods,
+                            unsigned char lnoise)
+{
+    unsigned char active;
+    unsigned char reg1;
+
+    if (lnoise && (data_range == 8))
+        return 1;
+
+    i2c_init(MMA8451_SLAVE_ADDRESS);
+    active = mma_configBegin();
+    if (active == CONFIG_FAILED)
+        return 1;
+
+    // Only registers that change are written
+    reg1 = (CMD_CTRL_REG1 & ~(DR_MASK | LNOISE))
+            | ((odr << DR_SHIFT) & DR_MASK) | (lnoise ? LNOISE : 0);
+    if (reg1 != CMD_CTRL_REG1)
+        mma_write(CTRL_REG1, reg1);
+    if ((mods & MODS_MASK) != (CMD_CTRL_REG2 & MODS_MASK))
+        mma_write(CTRL_REG2, (CMD_CTRL_REG2 & ~MODS_MASK) | (mods & MODS_MASK));
+    mma_configEnd(active);
+
+    return 0;
+}
+
+unsigned char mma_fifoEnable(unsigned char watermark)
+{
+    unsigned char active;
 
-    // Enabling the bit INT_CFG_PULSE for INT 1
-    mma_write(CTRL_REG5, 0x8);
+    if (watermark > MMA_FIFO_SIZE)
+        watermark = MMA_FIFO_SIZE;
 
-    // Interupt polarity
-    mma_write(CTRL_REG3, 0x2);
+    // F_MODE can only change in standby. Circular mode: the FIFO keeps
+    // the newest 32 samples and raises the watermark flag at <watermark>.
+    i2c_init(MMA8451_SLAVE_ADDRESS);
+    active = mma_configBegin();
+    if (active == CONFIG_FAILED)
+        return 1;
+    mma_write(F_SETUP, F_MODE_CIRC | (watermark & F_WMRK_MASK));
+    mma_configEnd(active);
+
+    return 0;
+}
+
+unsigned char mma_fifoDisable(void)
+{
+    unsigned char active;
+
+    i2c_init(MMA8451_SLAVE_ADDRESS);
+    active = mma_configBegin();
+    if (active == CONFIG_FAILED)
+        return 1;
+    mma_write(F_SETUP, 0x00);
+    mma_configEnd(active);
+
+    return 0;
+}
+
+unsigned char mma_fifoRead(mma_accel_t *block, unsigned char max)
+{
+    unsigned char r[1] = { F_STATUS };
+    unsigned char status;
+    unsigned char count;
+    unsigned char size = (CMD_CTRL_REG1 & F_READ) ? 3 : 6;
+    unsigned char *raw;
+    unsigned char i;
+
+    if (!(CMD_F_SETUP & F_MODE_MASK))
+        return 0;
+
+    i2c_init(MMA8451_SLAVE_ADDRESS);
+    if (i2c_write_read(1, r, 1, &status))
+        return 0;
+
+    count = status & F_CNT_MASK;
+    if (count > max)
+        count = max;
+    if (count == 0)
+        return 0;
+
+    // With the FIFO on, a burst from OUT_X_MSB wraps around after the Z
+    // axis and delivers the next sample, so all of them come in one read.
+    // The raw bytes go to the end of the block and are converted into
+    // mma_accel_t front to back; a sample is never overwritten before it
+    // has been converted (6 byte samples convert in place).
+    raw = (unsigned char *) block + count * (sizeof(mma_accel_t) - size);
+    r[0] = OUT_X_MSB;
+    if (i2c_write_read(1, r, count * size, raw))
+        return 0;
+
+    for (i = 0; i < count; i++)
+        mma_convert(raw + i * size, &block[i]);
+
+    return count;
+}
+
+unsigned char mma_dataReadyEnable(void)
+{
+    i2c_init(MMA8451_SLAVE_ADDRESS);
+    if (mma_configBegin() == CONFIG_FAILED)
+        return 1;
+
+    // Data-ready interrupt on INT1
+    mma_write(CTRL_REG4, CMD_CTRL_REG4 | INT_EN_DRDY);
+    mma_write(CTRL_REG5, CMD_CTRL_REG5 | INT_CFG_DRDY);
+
+    mma_intArm();
 
     set_active_mode();
+
+    // A sample that got ready before the edge was armed keeps INT1 asserted
+    mma_intKick();
     return 0;
+}
 
+unsigned char mma_dataReadyDisable(void)
+{
+    // Events keep using the pin
+    if (!(CMD_CTRL_REG4 & INT_EVENTS))
+        MMA_INT_IE &= ~MMA_INT_BIT;
+    while (mma_txn.status == I2C_PENDING)
+        i2c_service();
+
+    i2c_init(MMA8451_SLAVE_ADDRESS);
+    mma_write(CTRL_REG4, CMD_CTRL_REG4 & ~INT_EN_DRDY);
+    mma_write(CTRL_REG5, CMD_CTRL_REG5 & ~INT_CFG_DRDY);
+    return 0;
 }
 
-unsigned char mma_disableTapInterrupt(void)
+unsigned char mma_samplesAvailable(void)
 {
-    // Disabling the Interrupt pin
-    mma_write(CTRL_REG4, 0x0);
+    return drdy_head - drdy_tail;
+}
+
+unsigned char mma_getSample(mma_sample_t *sample)
+{
+    unsigned short state;
+
+    if (drdy_head == drdy_tail)
+        return 0;
+
+    // The ISR may replace the sample while it is copied
+    state = __get_interrupt_state();
+    __disable_interrupt();
+    *sample = drdy_ring[drdy_tail % MMA_RING_LEN];
+    drdy_tail++;
+    __set_interrupt_state(state);
+    return 1;
+}
+
+unsigned int mma_sampleOverruns(void)
+{
+    return drdy_overruns;
+}
+
+// Enable or disable <event> (an MMA_EVENT_*) in CTRL_REG4, routed to INT1
+unsigned char mma_eventConfig(unsigned char event, unsigned char on)
+{
+    if (on)
+    {
+        mma_write(CTRL_REG4, CMD_CTRL_REG4 | event);
+        mma_write(CTRL_REG5, CMD_CTRL_REG5 | event);
+    }
+    else
+        mma_write(CTRL_REG4, CMD_CTRL_REG4 & ~event);
+
     return 0;
 }
 
+unsigned char mma_setMotion(unsigned char axes, unsigned char threshold,
+                            unsigned char count, unsigned char freefall)
+{
+    unsigned char active;
+
+    i2c_init(MMA8451_SLAVE_ADDRESS);
+    active = mma_configBegin();
+    if (active == CONFIG_FAILED)
+        return 1;
+
+    // Latched; motion: any enabled axis above the threshold (OAE = 1),
+    // freefall: all enabled axes below it (OAE = 0)
+    mma_write(FF_MT_CFG, ELE_FF_MT | (freefall ? 0 : OAE)
+              | ((axes & MMA_AXES) << 3));
+    mma_write(FF_MT_THS, threshold & 0x7F);    // 0.063 g per count
+    mma_write(FF_MT_COUNT, count);             // debounce, in ODR periods
+    mma_eventConfig(MMA_EVENT_MOTION, axes != 0);
+
+    mma_configEnd(active);
+    return 0;
+}
+
+unsigned char mma_setTransient(unsigned char axes, unsigned char threshold,
+                               unsigned char count)
+{
+    unsigned char active;
+
+    i2c_init(MMA8451_SLAVE_ADDRESS);
+    active = mma_configBegin();
+    if (active == CONFIG_FAILED)
+        return 1;
+
+    // Latched, on the high-pass filtered data, so gravity and slow tilt
+    // do not count
+    mma_write(TRANSIENT_CFG, ELE_TRANSIENT | ((axes & MMA_AXES) << 1));
+    mma_write(TRANSIENT_THS, threshold & 0x7F);    // 0.063 g per count
+    mma_write(TRANSIENT_COUNT, count);
+    mma_eventConfig(MMA_EVENT_TRANSIENT, axes != 0);
+
+    mma_configEnd(active);
+    return 0;
+}
+
+unsigned char mma_setOrientation(unsigned char on, unsigned char count)
+{
+    unsigned char active;
+
+    i2c_init(MMA8451_SLAVE_ADDRESS);
+    active = mma_configBegin();
+    if (active == CONFIG_FAILED)
+        return 1;
+
+    mma_write(PL_CFG, DBCNTM | (on ? PL_EN : 0));  // debounce counter clears
+    mma_write(PL_COUNT, count);
+    mma_eventConfig(MMA_EVENT_ORIENTATION, on);
+
+    mma_configEnd(active);
+    return 0;
+}
+
+unsigned char mma_eventsDisable(unsigned char events)
+{
+    i2c_init(MMA8451_SLAVE_ADDRESS);
+    return mma_eventConfig(events & INT_EVENTS, 0);
+}
+
+void mma_pollEvents(void)
+{
+    // With the pin armed the interrupt does this, only a chain that ended
+    // on a failed read while INT1 stayed asserted is restarted
+    if (MMA_INT_IE & MMA_INT_BIT)
+        mma_intRecheck();
+    else if (CMD_CTRL_REG4 & INT_EVENTS)
+        mma_intKick();
+}
+
+unsigned char mma_intInUse(void)
+{
+    return (MMA_INT_IE & MMA_INT_BIT) != 0;
+}
+
+unsigned char mma_getEvent(mma_event_t *event)
+{
+    if (evt_head == evt_tail)
+        return 0;
+
+    *event = evt_ring[evt_tail % MMA_EVENT_LEN];
+    evt_tail++;
+    return 1;
+}
+
+unsigned char mma_motionIsFreefall(void)
+{
+    return !(CMD_FF_MT_CFG & OAE);
+}
+
+// Route MMA INT1 (MMA_INT_*) to the port interrupt, on the edge that
+// asserts it (CTRL_REG3 IPOL)
+void mma_intArm(void)
+{
+    MMA_INT_DIR &= ~MMA_INT_BIT;
+    MMA_INT_SEL &= ~MMA_INT_BIT;
+    MMA_INT_SEL2 &= ~MMA_INT_BIT;
+    if (CMD_CTRL_REG3 & IPOL)
+        MMA_INT_IES &= ~MMA_INT_BIT;           // active high, rising edge
+    else
+        MMA_INT_IES |= MMA_INT_BIT;            // active low, falling edge
+    MMA_INT_IFG &= ~MMA_INT_BIT;
+    MMA_INT_IE |= MMA_INT_BIT;
+}
+
+unsigned char mma_intAsserted(void)
+{
+    if (CMD_CTRL_REG3 & IPOL)
+        return (MMA_INT_IN & MMA_INT_BIT) != 0;
+    return !(MMA_INT_IN & MMA_INT_BIT);
+}
+
+// Find out why INT1 is asserted. With only data-ready enabled that is
+// known and the sample is read right away; otherwise INT_SOURCE first.
+void mma_intKick(void)
+{
+    unsigned short state = __get_interrupt_state();
+    __disable_interrupt();
+
+    if ((mma_txn.status != I2C_PENDING) && !drdy_pending && !evt_pending)
+    {
+        mma_tick = tick_now();
+        if (!(CMD_CTRL_REG4 & INT_EVENTS))
+        {
+            drdy_pending = 1;
+            mma_intNext();
+        }
+        else
+        {
+            mma_reg[0] = INT_SOURCE;
+            mma_txn.rlen = 1;
+            if (i2c_submit(&mma_txn) != I2C_PENDING)
+                evt_overruns++;
+        }
+    }
+
+    __set_interrupt_state(state);
+}
+
+// All reads done: if INT1 is still asserted, something new came up in
+// the meantime and there will be no new edge for it
+void mma_intRecheck(void)
+{
+    if ((MMA_INT_IE & MMA_INT_BIT) && mma_intAsserted())
+    {
+        MMA_INT_IFG &= ~MMA_INT_BIT;
+        mma_intKick();
+    }
+}
+
+// Start the next read for the interrupt: the sample, then the source
+// register of the lowest pending event; that read also clears the event
+void mma_intNext(void)
+{
+    unsigned char event = evt_pending & -evt_pending;      // lowest bit
+
+    mma_txn.rlen = 1;
+    if (drdy_pending)
+    {
+        mma_reg[0] = OUT_X_MSB;
+        mma_txn.rlen = (CMD_CTRL_REG1 & F_READ) ? 3 : 6;
+    }
+    else if (event == MMA_EVENT_MOTION)
+        mma_reg[0] = FF_MT_SRC;
+    else if (event == MMA_EVENT_TAP)
+        mma_reg[0] = PULSE_SRC;
+    else if (event == MMA_EVENT_ORIENTATION)
+        mma_reg[0] = PL_STATUS;
+    else if (event == MMA_EVENT_TRANSIENT)
+        mma_reg[0] = TRANSIENT_SRC;
+    else
+    {
+        evt_pending = 0;
+        mma_intRecheck();
+        return;
+    }
+
+    if (i2c_submit(&mma_txn) != I2C_PENDING)
+    {
+        if (drdy_pending)
+            drdy_overruns++;
+        else
+            evt_overruns++;
+        drdy_pending = 0;
+        evt_pending = 0;
+    }
+}
+
+// Completion of mma_txn, interrupt context
+void mma_txnDone(i2c_txn_t *txn)
+{
+    unsigned char event = evt_pending & -evt_pending;
+
+    // A failed read ends the chain. Starting over from here would spin for
+    // as long as INT1 stays asserted; mma_pollEvents() picks it up again.
+    if (txn->status != I2C_OK)
+    {
+        if (mma_reg[0] == OUT_X_MSB)
+            drdy_overruns++;
+        else
+            evt_overruns++;
+        drdy_pending = 0;
+        evt_pending = 0;
+        return;
+    }
+
+    if (mma_reg[0] == INT_SOURCE)
+    {
+        drdy_pending = (mma_raw[0] & INT_EN_DRDY)
+                && (CMD_CTRL_REG4 & INT_EN_DRDY);
+        evt_pending = mma_raw[0] & CMD_CTRL_REG4 & INT_EVENTS;
+    }
+    else if (mma_reg[0] == OUT_X_MSB)
+    {
+        // Full: the newest sample not taken yet makes room for this one
+        unsigned char full =
+                (unsigned char) (drdy_head - drdy_tail) >= MMA_RING_LEN;
+        mma_sample_t *sample = &drdy_ring[(drdy_head - full) % MMA_RING_LEN];
+
+        sample->tick = mma_tick;
+        mma_convert(mma_raw, &sample->acc);
+        if (full)
+            drdy_overruns++;
+        else
+            drdy_head++;
+        drdy_pending = 0;
+    }
+    else
+    {
+        if ((unsigned char) (evt_head - evt_tail) < MMA_EVENT_LEN)
+        {
+            mma_event_t *e = &evt_ring[evt_head % MMA_EVENT_LEN];
+
+            e->tick = mma_tick;
+            e->type = event;
+            e->src = mma_raw[0];
+            evt_head++;
+        }
+        else
+            evt_overruns++;
+        evt_pending &= ~event;
+    }
+
+    mma_intNext();
+}
+
+// MMA INT1 edge, called by the port dispatcher (interrupts.c)
+void mma_intISR(void)
+{
+    MMA_INT_IFG &= ~MMA_INT_BIT;
+    mma_intKick();
+}
+
+// One raw sample (3 MSBs in 8 bit mode, 3 MSB/LSB pairs otherwise) to
+// cm/s^2. <raw> may overlap <acc>, it is read completely first.
+void mma_convert(const unsigned char *raw, mma_accel_t *acc)
+{
+    unsigned int scale = ACC_SCALE_Q16[data_range >> 2];   // 2, 4, 8 g
+    int value[3];
+    int *out = &acc->x;
+    unsigned char i;
+
+    // Left-aligned 16 bit, in 8 bit mode the LSBs count as 0
+    for (i = 0; i < 3; i++)
+    {
+        if (CMD_CTRL_REG1 & F_READ)
+            value[i] = (int) ((unsigned int) raw[i] << 8);
+        else
+            value[i] = (int) (((unsigned int) raw[2 * i] << 8) | raw[2 * i + 1]);
+    }
+
+    for (i = 0; i < 3; i++)
+        out[i] = (int) (((long) value[i] * scale + 0x8000L) >> 16);
+}
+
 unsigned char mma_read(void)
 {
     //set_active_mode();
 
     // FMODE == 0
     unsigned char r[1] = { OUT_X_MSB };
-    i2c_write(1, r, 0);
 
     // if F_READ ==1
     if (data_resolution == 8)
     {
-        i2c_read(3, xyz_values_8bit);
+        return i2c_write_read(1, r, 3, xyz_values_14bit);
 
     }
-    // if F_READ ==0
-    if (data_resolution == 14)
-    {
-        i2c_read(6, xyz_values_14bit);
-    }
 
-    // FMODE == 1?
-    return 0;
+    // if F_READ ==0, OUT_X_MSB .. OUT_Z_LSB in one burst
+    return i2c_write_read(1, r, 6, xyz_values_14bit);
 }
 
 signed char mma_get8X(void)
@@ -25,20 +25,128 @@
  * CONSTANTS
  *****************************************************************************/
 
+#define MMA_FIFO_SIZE   32      // samples the MMA8451Q FIFO holds
+
+// Output data rates for mma_setDataRate()
+#define MMA_ODR_800HZ   0
+#define MMA_ODR_400HZ   1
+#define MMA_ODR_200HZ   2
+#define MMA_ODR_100HZ   3
+#define MMA_ODR_50HZ    4
+#define MMA_ODR_12_5HZ  5
+#define MMA_ODR_6_25HZ  6
+#define MMA_ODR_1_56HZ  7
+
+// Oversampling modes (MODS) for mma_setOversampling(). The MMA averages
+// more internal samples for lower noise at a higher supply current; how
+// much depends on the ODR (datasheet table "MODS oversampling").
+#define MMA_MODS_NORMAL 0
+#define MMA_MODS_LNLP   1       // low noise low power
+#define MMA_MODS_HIRES  2       // high resolution, lowest noise
+#define MMA_MODS_LP     3       // low power, highest noise
+
+// Achievable sample rates. One data-ready sample is a register write plus
+// a repeated-START burst: 84 bit times at 14 bit, 57 at 8 bit, and about
+// 80 CPU cycles per byte in the I2C ISRs. A FIFO drain of 32 samples is
+// one 192 byte burst.
+//
+//  profile  I2C       per sample       data-ready up to     FIFO (32)
+//  1 MHz    100 kHz   0.84 / 0.57 ms   400 Hz (bus 34 %)    800 Hz (bus 44 %)
+//  8 MHz    400 kHz   0.21 / 0.14 ms   800 Hz (bus 17 %)    800 Hz (bus 11 %)
+//  16 MHz   400 kHz   0.21 / 0.14 ms   800 Hz (bus 17 %)    800 Hz (bus 11 %)
+//
+// At 1 MHz and 800 Hz data-ready sampling the ISRs alone take ~60 % of
+// the CPU, so use the FIFO there. The dashboard itself shows one sample
+// per refresh whatever the ODR is.
+
+// Pin that MMA INT1 is jumpered to, P1.5 at the LED GREEN header. Port 2
+// is taken by the shift registers and the LCD, port 3 has no interrupts.
+// The LED code leaves the pin alone while mma_intInUse(). P1.0 (ultrasonic
+// echo) shares the port vector, interrupts.c dispatches it.
+#define MMA_INT_BIT     BIT5
+#define MMA_INT_IN      P1IN
+#define MMA_INT_DIR     P1DIR
+#define MMA_INT_SEL     P1SEL
+#define MMA_INT_SEL2    P1SEL2
+#define MMA_INT_IES     P1IES
+#define MMA_INT_IFG     P1IFG
+#define MMA_INT_IE      P1IE
+
+#define MMA_RING_LEN    1       // data-ready samples, must be a power of two
+
+// Events, the bit of the source in INT_SOURCE
+#define MMA_EVENT_MOTION        0x04    // freefall / motion (FF_MT)
+#define MMA_EVENT_TAP           0x08    // pulse
+#define MMA_EVENT_ORIENTATION   0x10    // portrait / landscape
+#define MMA_EVENT_TRANSIENT     0x20    // high-pass filtered motion
+
+#define MMA_EVENT_LEN   2       // event ring, must be a power of two
+
+// Axes for the motion and transient detection
+#define MMA_AXIS_X      0x01
+#define MMA_AXIS_Y      0x02
+#define MMA_AXIS_Z      0x04
+#define MMA_AXES        0x07
+
+// Session states
+#define MMA_SESSION_CLOSED      0   // not set up, or set up before an error
+#define MMA_SESSION_ACTIVE      1   // configured and measuring
+
 
 
 /******************************************************************************
  * VARIABLES
  *****************************************************************************/
 
+// One acceleration sample, all axes from the same burst, in cm/s^2
+// (0.01 m/s^2)
+typedef struct
+{
+    int x;
+    int y;
+    int z;
+} mma_accel_t;
+
+// Something the MMA detected, with the tick of its interrupt (or of the
+// poll that found it) and the content of the event's source register
+// (FF_MT_SRC, PULSE_SRC, PL_STATUS or TRANSIENT_SRC: axis, direction,
+// orientation)
+typedef struct
+{
+    unsigned long tick;
+    unsigned char type;             // MMA_EVENT_*
+    unsigned char src;
+} mma_event_t;
+
+// The MMA as used by an application: set up once, then only sampled.
+// It is set up again only after a failed read.
+typedef struct
+{
+    unsigned char state;            // MMA_SESSION_*
+    unsigned char resolution;       // as for mma_setResolution()
+    unsigned char range;            // as for mma_setRange()
+    unsigned char odr;              // MMA_ODR_*
+    unsigned char mods;             // MMA_MODS_*
+    unsigned char lnoise;           // low noise mode, ranges up to 4g only
+    unsigned int errors;            // failed reads so far
+} mma_session_t;
+
+// Acceleration sample with the tick of its data-ready interrupt
+typedef struct
+{
+    unsigned long tick;
+    mma_accel_t acc;
+} mma_sample_t;
 
 
 /******************************************************************************
  * FUNCTION PROTOTYPES
  *****************************************************************************/
 
-void set_standby_mode();
-void set_active_mode();
+// Mode changes, each polls SYSMOD until the MMA got there. Return 0 on
+// success, 1 if it did not within ~20 ms.
+unsigned char set_standby_mode();
+unsigned char set_active_mode();
 
 // All configuration functions return 0 if everything went fine
 // and anything but 0 if not (they are the ones with a unsigned char return type).
@@ -51,6 +159,21 @@ unsigned char mma_setRange(unsigned char range);
 // Change the resolution (0: 8 Bit, >= 1: 14 Bit) (0.5 pt.)
 unsigned char mma_setResolution(unsigned char resolution);
 
+// Open <session>: reset and configure the MMA with the session's
+// resolution, range, data rate, oversampling and low noise mode and
+// switch it to active mode. Returns 0 on success.
+unsigned char mma_sessionOpen(mma_session_t *session);
+
+// Read one sample. Opens the session first if it is not active; a failed
+// read closes it so the next call sets the MMA up again.
+unsigned char mma_sample(mma_session_t *session, mma_accel_t *acc);
+
+// Reload the driver's copy of the MMA registers from the chip, e.g. after
+// a bus error or a brown-out of the sensor. The driver otherwise never
+// reads the configuration back, it trusts what it wrote. If a read fails
+// the shadows are left as they were and 1 is returned.
+unsigned char mma_resync(void);
+
 // Run a self-test on the MMA, verifying that all three axis and all three
 // measurement ranges are working. (1 pt.)
 /* HINT:
@@ -92,6 +215,79 @@ unsigned char mma_disableTapInterrupt(void);
 unsigned char mma_read(void);
 
 
+// Burst read all three axes and convert them to cm/s^2 with integer math.
+// Selects the MMA on the bus itself. Returns 0 on success.
+unsigned char mma_readAccel(mma_accel_t *acc);
+
+// Change the output data rate (MMA_ODR_*). Also the rate the FIFO fills.
+unsigned char mma_setDataRate(unsigned char rate);
+
+// Change the oversampling mode (MMA_MODS_*).
+unsigned char mma_setOversampling(unsigned char mods);
+
+// Low noise mode (1: on). Limits the range to 4g, so it is refused (1)
+// while the range is 8g.
+unsigned char mma_setLowNoise(unsigned char on);
+
+// Data rate, oversampling and low noise mode in one standby window
+unsigned char mma_configure(unsigned char odr, unsigned char mods,
+                            unsigned char lnoise);
+
+// Turn on the FIFO in circular mode with a watermark of <watermark>
+// samples (1..32). mma_read()/mma_readAccel() then return the oldest
+// sample in the FIFO, so use mma_fifoRead() while it is on.
+unsigned char mma_fifoEnable(unsigned char watermark);
+unsigned char mma_fifoDisable(void);
+
+// Move the samples in the FIFO, at most <max>, into <block> with a single
+// burst read and convert them to cm/s^2. Returns the number of samples.
+unsigned char mma_fifoRead(mma_accel_t *block, unsigned char max);
+
+// Sample at the output data rate: the MMA signals data-ready on INT1
+// (MMA_INT_*), the port ISR starts an I2C read in the background and the
+// converted sample goes into a ring with the tick of the interrupt. With
+// the ring full the newest sample in it is replaced, so the ring always
+// ends with the latest one.
+unsigned char mma_dataReadyEnable(void);
+unsigned char mma_dataReadyDisable(void);
+
+// Number of samples in the ring
+unsigned char mma_samplesAvailable(void);
+// Take the oldest sample out of the ring. Returns 0 if it is empty.
+unsigned char mma_getSample(mma_sample_t *sample);
+// Samples lost because they were replaced in the ring, the I2C queue was
+// full or the read failed
+unsigned int mma_sampleOverruns(void);
+
+// Event detection on the MMA. Events are routed to INT1 and decoded from
+// INT_SOURCE into a ring: by the port interrupt while the pin is armed
+// (data-ready sampling on), otherwise by mma_pollEvents().
+
+// Motion (<freefall> 0: any of <axes> above <threshold>) or freefall
+// (all of <axes> below it). <threshold> in 0.063 g, <count> debounce in
+// ODR periods. <axes> 0 turns it off.
+unsigned char mma_setMotion(unsigned char axes, unsigned char threshold,
+                            unsigned char count, unsigned char freefall);
+// Like motion, on high-pass filtered data
+unsigned char mma_setTransient(unsigned char axes, unsigned char threshold,
+                               unsigned char count);
+// Portrait / landscape changes, <count> debounce in ODR periods
+unsigned char mma_setOrientation(unsigned char on, unsigned char count);
+// Turn off the given MMA_EVENT_* bits, including tap
+unsigned char mma_eventsDisable(unsigned char events);
+
+// Check INT_SOURCE for events in the background if the pin is not armed,
+// otherwise restart the reads if one failed while INT1 stayed asserted.
+// Call it from the main loop.
+void mma_pollEvents(void);
+// 1 while INT1 is armed on MMA_INT_BIT, i.e. the driver owns the pin
+unsigned char mma_intInUse(void);
+// Take the oldest event out of the ring. Returns 0 if it is empty.
+unsigned char mma_getEvent(mma_event_t *event);
+// 1 if MMA_EVENT_MOTION currently means freefall
+unsigned char mma_motionIsFreefall(void);
+
+
 /* Get Functions (1 pt. total): */
 
 // Return the appropriate 8 bit values
@@ -0,0 +1,61 @@
+/***************************************************************************//**
+ * @file    ntc_table.h
+ *
+ * @brief   NTC temperature table
+ *
+ * Generated by tools/gen_tables.py, do not edit.
+ ******************************************************************************/
+
+#ifndef LIBS_NTC_TABLE_H_
+#define LIBS_NTC_TABLE_H_
+
+// NTC 10000 Ohm / B 3950 K against 10000 Ohm, clamped to -40 .. 150 degC.
+// Segments start at ADC code X with Y tenths of degC and rise by
+// SLOPE per code, both with TABLE_SHIFT fraction bits. INDEX holds
+// the segment of every 1 << INDEX_SHIFT codes.
+
+// Curve and tolerance the table was generated for
+#define NTC_R25                10000.0
+#define NTC_BETA               3950.0
+#define NTC_R_FIXED            10000.0
+#define NTC_T_MIN              -40.0
+#define NTC_T_MAX              150.0
+#define NTC_TOLERANCE          0.2
+
+#define NTC_TABLE_LEN 30
+#define NTC_TABLE_SHIFT 4
+#define NTC_INDEX_SHIFT 4
+
+const unsigned int NTC_TABLE_X[31] =
+{
+    0, 21, 25, 30, 36, 42, 50, 61,
+    72, 85, 101, 121, 145, 171, 210, 252,
+    312, 380, 450, 520, 748, 816, 869, 906,
+    933, 958, 975, 988, 998, 999, 1024
+};
+
+const int NTC_TABLE_Y[30] =
+{
+    24000, 23658, 22401, 21131, 19902, 18892, 17781, 16549,
+    15547, 14565, 13564, 12532, 11510, 10586, 9434, 8403,
+    7168, 5978, 4893, 3888, 661, -461, -1493, -2361,
+    -3129, -4014, -4785, -5541, -6299, -6388
+};
+
+const int NTC_TABLE_SLOPE[30] =
+{
+    -16, -314, -254, -205, -168, -139, -112, -91,
+    -76, -63, -52, -43, -36, -30, -25, -21,
+    -18, -16, -14, -14, -16, -19, -23, -28,
+    -35, -45, -58, -76, -89, 0
+};
+
+const unsigned char NTC_TABLE_INDEX[64] =
+{
+    0, 0, 3, 5, 7, 8, 9, 10, 11, 11, 12, 13, 13, 13, 14, 14,
+    15, 15, 15, 15, 16, 16, 16, 16, 17, 17, 17, 17, 17, 18, 18, 18,
+    18, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 20,
+    20, 20, 20, 21, 21, 21, 21, 22, 22, 23, 23, 24, 25, 26, 27, 29
+};
+
+#endif /* LIBS_NTC_TABLE_H_ */
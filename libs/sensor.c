@@ -22,11 +22,45 @@
 /*****************************************************************************/
 
 #include "./sensor.h"
+#include "./clock.h"
+#include "./ntc_table.h"
+#include "./ldr_table.h"
 
 /******************************************************************************
  * VARIABLES
  *****************************************************************************/
 
+#define CH_NTC  0
+#define CH_LDR  1
+#define CH_POT  2
+
+// Filled by the DTC, A4 down to A0. A1/A2 are the UART pins; they are on
+// the way of the sequence, their results are not used. In the background
+// the DTC starts over after every sequence; the ADC10 ISR takes the values
+// out before the next timer edge overwrites A4, one conversion period
+// (1 / (5 * rate)) later.
+unsigned int adc_ring[5];
+unsigned char bg_running = 0;
+unsigned char bg_extra;             // extra bits by decimation
+unsigned char bg_shift;             // running average weight 1 / 2^shift
+volatile unsigned char bg_skip;     // scans to drop
+unsigned char bg_count;             // samples in the sums
+unsigned int bg_sum[3];
+volatile unsigned int bg_avg[3];    // running average, 3 fraction bits
+unsigned char bg_valid = 0;         // bg_avg holds a result
+
+const sensor_table_t ntc_table =
+{
+    NTC_TABLE_X, NTC_TABLE_Y, NTC_TABLE_SLOPE, NTC_TABLE_INDEX,
+    NTC_TABLE_SHIFT, NTC_INDEX_SHIFT
+};
+
+const sensor_table_t ldr_table =
+{
+    LDR_TABLE_X, LDR_TABLE_Y, LDR_TABLE_SLOPE, LDR_TABLE_INDEX,
+    LDR_TABLE_SHIFT, LDR_INDEX_SHIFT
+};
+
 /******************************************************************************
  * FUNCTION IMPLEMENTATION
  *****************************************************************************/
@@ -39,8 +73,9 @@ void clockReset(void)
 
 void sensor_init()
 {
-    //Turn ADC on;
-    ADC10CTL0 = ADC10ON + ADC10SHT_2;
+    //Turn ADC on; background sampling keeps its own setup
+    if (!bg_running)
+        ADC10CTL0 = ADC10ON + ADC10SHT_2;
 
     // Setting directions for shift registers
     P2DIR |= (BIT0 | BIT1 | BIT2 | BIT3 | BIT4 | BIT5 | BIT6);
@@ -66,8 +101,36 @@ void sensor_init()
 
 }
 
+// Latest filtered value of <ch> at 10 bits
+int bg_value(unsigned char ch)
+{
+    unsigned char shift = bg_extra + 3;
+
+    return (bg_avg[ch] + (1 << (shift - 1))) >> shift;
+}
+
+// ADC10 and DTC setup of the background sampling, Timer0_A paces it
+void bg_arm(void)
+{
+    // One conversion per rising edge of TA0.1, the sequence repeats
+    ADC10CTL0 = ADC10ON + ADC10SHT_2 + ADC10IE;
+    ADC10CTL1 = INCH_4 + SHS_1 + CONSEQ_3;
+    ADC10DTC0 = ADC10CT;                      // one block, continuous
+    ADC10DTC1 = 5;                            // one sequence per block
+    ADC10SA = (unsigned int) adc_ring;
+    ADC10CTL0 |= ENC;
+}
+
 int get_ntc()
 {
+    sensor_analog_t snapshot;
+
+    if (bg_running)
+    {
+        sensor_readAnalog(&snapshot);
+        return snapshot.ntc;
+    }
+
     ADC10AE0 |= BIT0;
     ADC10CTL1 = INCH_0;
 
@@ -90,6 +153,14 @@ int get_ntc()
 
 int get_ldr()
 {
+    sensor_analog_t snapshot;
+
+    if (bg_running)
+    {
+        sensor_readAnalog(&snapshot);
+        return snapshot.ldr;
+    }
+
     ADC10AE0 |= BIT3;
     ADC10CTL1 = INCH_3;
 
@@ -110,6 +181,13 @@ int get_ldr()
 
 int get_pot()
 {
+    sensor_analog_t snapshot;
+
+    if (bg_running)
+    {
+        sensor_readAnalog(&snapshot);
+        return snapshot.pot;
+    }
 
     ADC10AE0 |= BIT4;
     ADC10CTL1 = INCH_4;
@@ -129,6 +207,185 @@ int get_pot()
     return pot_value;
 }
 
+void sensor_readAnalog(sensor_analog_t *snapshot)
+{
+    unsigned char ae = ADC10AE0;
+
+    if (bg_running && bg_valid)
+    {
+        snapshot->ntc = bg_value(CH_NTC);
+        snapshot->ldr = bg_value(CH_LDR);
+        snapshot->pot = bg_value(CH_POT);
+        return;
+    }
+
+    // No background result yet: pause it for a scan of our own. Its sums
+    // are kept, the sequence starts over at A4 afterwards.
+    if (bg_running)
+    {
+        TA0CTL &= ~MC_3;
+        ADC10CTL0 &= ~(ADC10IE | ENC);
+        while (ADC10CTL1 & ADC10BUSY)
+            ;
+    }
+
+    // Analog function for NTC (A0), LDR (A3) and U_POT (A4) only
+    ADC10AE0 |= (BIT0 | BIT3 | BIT4);
+
+    ADC10CTL0 &= ~ENC;
+    ADC10CTL0 = ADC10ON + ADC10SHT_2 + MSC;    // one trigger for all
+    ADC10CTL1 = INCH_4 + CONSEQ_1;            // sequence A4 .. A0
+    ADC10DTC0 = 0;                            // one block, then stop
+    ADC10DTC1 = 5;                            // transfers per block
+    ADC10SA = (unsigned int) adc_ring;        // starts the DTC
+
+    ADC10CTL0 |= ENC + ADC10SC;
+
+    // Set once the DTC has written the whole block
+    while (!(ADC10CTL0 & ADC10IFG))
+        ;
+
+    ADC10CTL0 &= ~(ENC | ADC10IFG);
+    ADC10DTC1 = 0;                            // DTC off for get_ntc() etc.
+    ADC10AE0 &= ~(BIT0 | BIT3 | BIT4);
+
+    snapshot->pot = adc_ring[0];
+    snapshot->ldr = adc_ring[1];
+    snapshot->ntc = adc_ring[4];
+
+    if (bg_running)
+    {
+        ADC10AE0 = ae;                        // P1.0 may be on hold
+        bg_arm();
+        TA0CTL |= MC_1;
+    }
+}
+
+void sensor_startBackground(unsigned int rate_hz, unsigned char extra_bits,
+                            unsigned char avg_shift)
+{
+    unsigned long period;
+
+    sensor_stopBackground();
+
+    if (extra_bits > SENSOR_MAX_EXTRA_BITS)
+        extra_bits = SENSOR_MAX_EXTRA_BITS;
+    bg_extra = extra_bits;
+    bg_shift = avg_shift;
+    bg_count = 0;
+    bg_sum[CH_NTC] = bg_sum[CH_LDR] = bg_sum[CH_POT] = 0;
+    bg_valid = 0;
+    bg_skip = 1;                              // settle after the switch
+
+    ADC10AE0 |= (BIT0 | BIT3 | BIT4);
+    bg_arm();
+
+    // Timer at SMCLK / 8, one period per conversion
+    period = (CLOCK_HZ / 8) / (5UL * rate_hz);
+    if (period < 2)
+        period = 2;
+    if (period > 65535UL)
+        period = 65535UL;
+
+    TA0CTL = TASSEL_2 + ID_3 + TACLR;
+    TA0CCR0 = period - 1;
+    TA0CCR1 = period / 2;
+    TA0CCTL1 = OUTMOD_3;                      // set at CCR1, reset at CCR0
+    bg_running = 1;
+    TA0CTL |= MC_1;
+}
+
+void sensor_stopBackground(void)
+{
+    if (!bg_running)
+        return;
+
+    TA0CTL = MC_0;
+    TA0CCTL1 = 0;
+    ADC10CTL0 &= ~ENC;
+    while (ADC10CTL1 & ADC10BUSY)
+        ;
+    ADC10CTL0 &= ~(ADC10IE | ADC10IFG);
+    ADC10CTL1 = 0;
+    ADC10DTC0 = 0;
+    ADC10DTC1 = 0;
+    ADC10AE0 &= ~(BIT0 | BIT3 | BIT4);
+    bg_running = 0;
+}
+
+void sensor_readPrecise(sensor_analog_t *snapshot)
+{
+    unsigned short state = __get_interrupt_state();
+    __disable_interrupt();
+
+    snapshot->ntc = bg_avg[CH_NTC] >> 3;
+    snapshot->ldr = bg_avg[CH_LDR] >> 3;
+    snapshot->pot = bg_avg[CH_POT] >> 3;
+
+    __set_interrupt_state(state);
+}
+
+void sensor_hold(unsigned char on)
+{
+    if (!bg_running)
+        return;
+
+    if (on)
+    {
+        bg_skip = 0xFF;                       // drop until released
+        ADC10AE0 &= ~BIT0;                    // digital input for RX_COMP
+    }
+    else
+    {
+        ADC10AE0 |= BIT0;
+        bg_skip = 2;                          // the one running and the next
+    }
+}
+
+int sensor_interpolate(const sensor_table_t *t, unsigned int adc)
+{
+    // The index entry is the segment at the start of this block of codes,
+    // the generator keeps the walk from there short
+    unsigned char seg = t->index[adc >> t->index_shift];
+
+    while (adc >= t->x[seg + 1])
+        seg++;
+
+    // The generator keeps the sum within an int. >> is arithmetic on the
+    // MSP430, so this rounds to the nearest unit like tools/gen_tables.py
+    return (t->y[seg] + t->slope[seg] * (int) (adc - t->x[seg])
+            + ((1 << t->shift) >> 1)) >> t->shift;
+}
+
+int sensor_ntcTemperature(unsigned int adc)
+{
+    if (adc > 1023)
+        adc = 1023;
+    return sensor_interpolate(&ntc_table, adc);
+}
+
+int sensor_ldrLux(unsigned int adc)
+{
+    if (adc > 1023)
+        adc = 1023;
+    return sensor_interpolate(&ldr_table, adc);
+}
+
+unsigned char sensor_classify(sensor_class_t *cls, unsigned int value)
+{
+    unsigned char level = cls->level;
+
+    while ((level < cls->count - 1) && (value >= cls->bounds[level].rise))
+        level++;
+    while ((level > 0) && (value < cls->bounds[level - 1].fall))
+        level--;
+
+    if (level == cls->level)
+        return 0;
+    cls->level = level;
+    return 1;
+}
+
 int get_pb()
 {
     int pb_value = 0;
@@ -177,3 +434,40 @@ int get_pb()
 
 }
 
+// One sequence is in adc_ring, A4 first
+#pragma vector = ADC10_VECTOR
+__interrupt void ADC10_ISR(void)
+{
+    unsigned int value[3];
+    unsigned char ch;
+
+    if (bg_skip)
+    {
+        if (bg_skip != 0xFF)
+            bg_skip--;
+        bg_count = 0;
+        bg_sum[CH_NTC] = bg_sum[CH_LDR] = bg_sum[CH_POT] = 0;
+        return;
+    }
+
+    bg_sum[CH_POT] += adc_ring[0];
+    bg_sum[CH_LDR] += adc_ring[1];
+    bg_sum[CH_NTC] += adc_ring[4];
+
+    if (++bg_count < (1 << (2 * bg_extra)))
+        return;
+
+    // 4^n samples summed, shifted right by n: n more bits
+    for (ch = 0; ch < 3; ch++)
+    {
+        value[ch] = bg_sum[ch] >> bg_extra;
+        bg_sum[ch] = 0;
+
+        if (!bg_valid)
+            bg_avg[ch] = value[ch] << 3;
+        else
+            bg_avg[ch] += (((long) (value[ch] << 3) - bg_avg[ch]) >> bg_shift);
+    }
+    bg_count = 0;
+    bg_valid = 1;
+}
@@ -21,6 +21,52 @@
  * CONSTANTS
  *****************************************************************************/
 
+#define SENSOR_MAX_EXTRA_BITS   3   // 4^3 = 64 conversions per result
+
+// Telemetry event for a class change, next to the MMA_EVENT_* bits
+#define SENSOR_EVENT_LIGHT      0x40
+
+/******************************************************************************
+ * VARIABLES
+ *****************************************************************************/
+
+// All analog channels, converted in one pass
+typedef struct
+{
+    unsigned int ntc;           // A0
+    unsigned int ldr;           // A3
+    unsigned int pot;           // A4
+} sensor_analog_t;
+
+// Boundary between class n and n + 1. The level is raised at <rise> or
+// more and lowered again below <fall>, fall < rise; the gap in between is
+// the hysteresis band.
+typedef struct
+{
+    unsigned int rise;
+    unsigned int fall;
+} sensor_bound_t;
+
+// Classifier state, <count> classes and count - 1 ascending bounds
+typedef struct
+{
+    const sensor_bound_t *bounds;
+    unsigned char count;
+    unsigned char level;        // current class, 0 .. count - 1
+} sensor_class_t;
+
+// Segment table generated by tools/gen_tables.py. Values and slopes carry
+// <shift> fraction bits.
+typedef struct
+{
+    const unsigned int *x;      // first ADC code of each segment, then 1024
+    const int *y;               // value at x
+    const int *slope;           // rise per ADC code
+    const unsigned char *index; // segment of every 1 << index_shift codes
+    unsigned char shift;
+    unsigned char index_shift;
+} sensor_table_t;
+
 /******************************************************************************
  * FUNCTION PROTOTYPES
  *****************************************************************************/
@@ -33,6 +79,46 @@ int get_ldr(void);
 
 int get_pot(void);
 
+// Convert A4 .. A0 in one sequence (CONSEQ_1) with the results moved to
+// memory by the DTC, and fill <snapshot>. The values are at most a few
+// conversion times apart. While background sampling runs, this returns
+// the filtered values instead, without converting; until the background
+// has its first result it converts once in between.
+void sensor_readAnalog(sensor_analog_t *snapshot);
+
+// Background sampling: TA0.1 triggers one conversion of the A4 .. A0
+// sequence every 1 / (5 * <rate_hz>) s, so every channel is sampled at
+// <rate_hz>. 4^<extra_bits> samples are summed and decimated into one
+// result with <extra_bits> more bits, and the results are smoothed by a
+// running average with a weight of 1 / 2^<avg_shift>. get_ntc(),
+// get_ldr(), get_pot() and sensor_readAnalog() then return the latest
+// filtered value at 10 bits right away. Uses Timer0_A.
+void sensor_startBackground(unsigned int rate_hz, unsigned char extra_bits,
+                            unsigned char avg_shift);
+void sensor_stopBackground(void);
+
+// Filtered values with 10 + <extra_bits> bits
+void sensor_readPrecise(sensor_analog_t *snapshot);
+
+// Pause background sampling (<on> 1) while P1.0 is used as the ultrasonic
+// RX_COMP input; the first scan after resuming is dropped as well.
+void sensor_hold(unsigned char on);
+
+// NTC reading (10 bit ADC code) in tenths of degC, from the table that
+// tools/gen_tables.py generates into ntc_table.h
+int sensor_ntcTemperature(unsigned int adc);
+
+// LDR reading (10 bit ADC code) in lux, from ldr_table.h
+int sensor_ldrLux(unsigned int adc);
+
+// Move <cls> to the class of <value>, crossing a boundary only past its
+// hysteresis band. Returns 1 if the class changed.
+unsigned char sensor_classify(sensor_class_t *cls, unsigned int value);
+
+// Value of the 10 bit ADC code <adc> on a generated segment table, rounded
+// to a whole unit. One multiply, no division.
+int sensor_interpolate(const sensor_table_t *t, unsigned int adc);
+
 int get_pb(void);
 
 #endif /* LIBS_SENSOR_H_ */
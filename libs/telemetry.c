@@ -0,0 +1,171 @@
+/***************************************************************************//**
+ * @file    telemetry.c
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   Binary telemetry: CRC protected, COBS framed records
+ *
+ * Record layout see telemetry.h.
+ ******************************************************************************/
+
+#include "./telemetry.h"
+
+/******************************************************************************
+ * VARIABLES
+ *****************************************************************************/
+
+unsigned int telemetry_seq = 0;
+
+// Record being framed. Bytes go straight into the transmit queue; only the
+// code byte of the current COBS block waits there, reserved, until the
+// block ends at the next zero.
+typedef struct
+{
+    unsigned int crc;
+    unsigned char code;         // slot of the open code byte
+    unsigned char run;          // its value: block length + 1
+} frame_t;
+
+/******************************************************************************
+ * LOCAL FUNCTION PROTOTYPES
+ *****************************************************************************/
+
+unsigned int crc16Update(unsigned int crc, unsigned char c);
+void frameStart(frame_t *f);
+void frameByte(frame_t *f, unsigned char c);
+void frameEnd(frame_t *f);
+void put8(frame_t *f, unsigned char v);
+void put16(frame_t *f, unsigned int v);
+void put32(frame_t *f, unsigned long v);
+
+/******************************************************************************
+ * LOCAL FUNCTION IMPLEMENTATION
+ *****************************************************************************/
+
+unsigned int crc16Update(unsigned int crc, unsigned char c)
+{
+    unsigned char i;
+
+    crc ^= (unsigned int) c << 8;
+    for (i = 0; i < 8; i++)
+    {
+        if (crc & 0x8000)
+            crc = (crc << 1) ^ 0x1021;
+        else
+            crc <<= 1;
+    }
+    return crc;
+}
+
+void frameStart(frame_t *f)
+{
+    serialFrameStart();
+    serialWrite(0x00);          // ends whatever text came before
+    f->crc = 0xFFFF;
+    f->code = serialReserve();
+    f->run = 1;
+}
+
+// COBS, records are far shorter than the 254 bytes of a full block
+void frameByte(frame_t *f, unsigned char c)
+{
+    if (c == 0)
+    {
+        // Zero ends a block: its code byte holds the distance to here
+        serialPatch(f->code, f->run);
+        f->code = serialReserve();
+        f->run = 1;
+    }
+    else
+    {
+        serialWrite(c);
+        f->run++;
+    }
+}
+
+void frameEnd(frame_t *f)
+{
+    unsigned int crc = f->crc;
+
+    frameByte(f, crc & 0xFF);
+    frameByte(f, crc >> 8);
+    serialPatch(f->code, f->run);
+    serialWrite(0x00);          // record delimiter
+}
+
+void put8(frame_t *f, unsigned char v)
+{
+    f->crc = crc16Update(f->crc, v);
+    frameByte(f, v);
+}
+
+void put16(frame_t *f, unsigned int v)
+{
+    put8(f, v & 0xFF);
+    put8(f, v >> 8);
+}
+
+void put32(frame_t *f, unsigned long v)
+{
+    put16(f, v & 0xFFFF);
+    put16(f, v >> 16);
+}
+
+/******************************************************************************
+ * FUNCTION IMPLEMENTATION
+ *****************************************************************************/
+
+unsigned int telemetry_crc16(const unsigned char *data, unsigned char length)
+{
+    unsigned int crc = 0xFFFF;
+
+    while (length--)
+        crc = crc16Update(crc, *data++);
+    return crc;
+}
+
+void telemetry_send(const unsigned char *record, unsigned char length)
+{
+    frame_t f;
+
+    frameStart(&f);
+    while (length--)
+        put8(&f, *record++);
+    frameEnd(&f);
+}
+
+void telemetry_sendSample(const telemetry_sample_t *sample)
+{
+    frame_t f;
+
+    frameStart(&f);
+    put8(&f, TELEMETRY_SAMPLE);
+    put16(&f, telemetry_seq++);
+    put32(&f, sample->tick);
+    put16(&f, sample->range);
+    put16(&f, sample->acc[0]);
+    put16(&f, sample->acc[1]);
+    put16(&f, sample->acc[2]);
+    put8(&f, sample->joy_x);
+    put8(&f, sample->joy_y);
+    put16(&f, sample->pot);
+    put16(&f, sample->ldr);
+    put16(&f, sample->ntc);
+    put8(&f, sample->pb);
+    put8(&f, sample->range_conf);
+    put8(&f, sample->range_count);
+    frameEnd(&f);
+}
+
+void telemetry_sendEvent(const telemetry_event_t *event)
+{
+    frame_t f;
+
+    frameStart(&f);
+    put8(&f, TELEMETRY_EVENT);
+    put16(&f, telemetry_seq++);
+    put32(&f, event->tick);
+    put8(&f, event->event);
+    put8(&f, event->src);
+    frameEnd(&f);
+}
@@ -0,0 +1,104 @@
+/***************************************************************************//**
+ * @file    telemetry.h
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   Binary telemetry header
+ *
+ * Every record is sent as
+ *
+ *   0x00 COBS( type | payload | CRC-16 ) 0x00
+ *
+ * All multi-byte fields are little endian. The CRC is CRC-16/CCITT-FALSE
+ * (polynomial 0x1021, start value 0xFFFF) over type and payload. COBS
+ * removes every 0x00 from the record, so a 0x00 always marks a record
+ * boundary and a receiver can resynchronise at any point, even after
+ * console text.
+ *
+ * Sample record (type 0x01), 26 bytes before CRC:
+ *
+ *   type u8 | seq u16 | tick u32 | range_mm i16 | acc_x i16 | acc_y i16 |
+ *   acc_z i16 | joy_x u8 | joy_y u8 | pot u16 | ldr u16 | ntc u16 | pb u8 |
+ *   range_conf u8 | range_count u8
+ *
+ * Event record (type 0x02), 9 bytes before CRC:
+ *
+ *   type u8 | seq u16 | tick u32 | event u8 | src u8
+ *
+ * For the accelerometer, event is an MMA_EVENT_* bit (libs/mma.h) and src
+ * the content of its source register.
+ * SENSOR_EVENT_LIGHT (libs/sensor.h) reports a new LDR light class in src,
+ * 0 (dark) to 3 (high).
+ *
+ * range_mm is -1 if the last ultrasonic measurement got no echo. range_conf
+ * is its confidence in %, range_count the number of pings with an echo.
+ * Acceleration is in 0.01 m/s^2, tick in units of TICK_US. The tool
+ * tools/telemetry_decode.py turns a captured stream into CSV.
+ ******************************************************************************/
+
+#ifndef LIBS_TELEMETRY_H_
+#define LIBS_TELEMETRY_H_
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+
+#include "./uart.h"
+
+/******************************************************************************
+ * CONSTANTS
+ *****************************************************************************/
+
+#define TELEMETRY_SAMPLE    0x01    // record types
+#define TELEMETRY_EVENT     0x02
+
+// Records are framed straight into the UART transmit queue. A COBS block
+// waits there until it is complete, so type, payload and CRC together
+// must not exceed TX_BUFFER_SIZE - 4 bytes. The sample record needs 28.
+
+/******************************************************************************
+ * VARIABLES
+ *****************************************************************************/
+
+// One acquisition cycle
+typedef struct
+{
+    unsigned long tick;
+    int range;                  // mm
+    int acc[3];                 // 0.01 m/s^2
+    unsigned char joy_x;
+    unsigned char joy_y;
+    unsigned int pot;
+    unsigned int ldr;
+    unsigned int ntc;
+    unsigned char pb;           // PB1 in bit 0 ... PB6 in bit 5
+    unsigned char range_conf;   // %
+    unsigned char range_count;  // pings with an echo
+} telemetry_sample_t;
+
+// Something a sensor detected (e.g. an MMA_EVENT_*), when it happened
+typedef struct
+{
+    unsigned long tick;
+    unsigned char event;
+    unsigned char src;          // event specific detail
+} telemetry_event_t;
+
+/******************************************************************************
+ * FUNCTION PROTOTYPES
+ *****************************************************************************/
+
+// Queue one sample record on the UART. The sequence number is added here
+// and counts every record sent.
+void telemetry_sendSample(const telemetry_sample_t *sample);
+
+// Queue one event record, numbered like the samples.
+void telemetry_sendEvent(const telemetry_event_t *event);
+
+// Frame and queue an arbitrary record of <length> bytes (type first).
+void telemetry_send(const unsigned char *record, unsigned char length);
+
+// CRC-16/CCITT-FALSE of <length> bytes
+unsigned int telemetry_crc16(const unsigned char *data, unsigned char length);
+
+#endif /* LIBS_TELEMETRY_H_ */
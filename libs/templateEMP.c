@@ -19,6 +19,7 @@
 
 #define NO_TEMPLATE_UART
 #include "./templateEMP.h"
+#include "./clock.h"
 
 /******************************************************************************
  * VARIABLES
@@ -264,19 +265,17 @@ void initMSP(void)
     // Stop Watchdog Timer
     WDTCTL = WDTPW + WDTHOLD;
     // If the calibration constants were erased, stop here.
-    if (CALBC1_1MHZ == 0xFF || CALDCO_1MHZ == 0xFF)
+    if (CLOCK_CALBC1 == 0xFF || CLOCK_CALDCO == 0xFF)
     {
         while (1)
             ;
     }
 
-    // Set clock to 1 MHz. Please don't change this if you have to upload/share
-    // your code during the lab.
-    // Possible options: _1 _8 _12 _16. Don't forget to adapt UART if you
-    // change this!
-    BCSCTL1 = CALBC1_1MHZ;
+    // Set clock to the selected profile (1 MHz unless CLOCK_PROFILE says
+    // otherwise, see clock.h). UART, I2C and delays follow automatically.
+    BCSCTL1 = CLOCK_CALBC1;
     // Set DCO step + modulation
-    DCOCTL = CALDCO_1MHZ;
+    DCOCTL = CLOCK_CALDCO;
 
 #ifndef NO_TEMPLATE_UART
     // Activate UART on 1.1 / 1.2
@@ -284,9 +283,9 @@ void initMSP(void)
     P1SEL = BIT1 + BIT2;           // P1.1 = RXD, P1.2=TXD, set everything
     P1SEL2 = BIT1 + BIT2;           // else as a normal GPIO.
     UCA0CTL1 |= UCSSEL_2;           // Use the SMCLK
-    UCA0BR0 = 104;                  // 9600 Baud at 1 MHz
-    UCA0BR1 = 0;                    // 9600 Baud at 1 MHz
-    UCA0MCTL = UCBRS0;              // Modulation UCBRSx = 1
+    UCA0BR0 = UART_BR0;             // UART_BAUD at CLOCK_HZ
+    UCA0BR1 = UART_BR1;
+    UCA0MCTL = UART_MCTL;           // Modulation UCBRSx
     UCA0CTL1 &= ~UCSWRST;           // Initialize USCI state machine
     IE2 |= UCA0RXIE;                // Enable USCI_A0 RX interrupt
 #endif  /*NO_TEMPLATE_UART*/
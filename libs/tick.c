@@ -0,0 +1,46 @@
+/***************************************************************************//**
+ * @file    tick.c
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   System tick from the watchdog interval timer
+ *
+ * Here goes a detailed description if required.
+ ******************************************************************************/
+
+#include "./tick.h"
+
+/******************************************************************************
+ * VARIABLES
+ *****************************************************************************/
+
+volatile unsigned long ticks = 0;
+
+/******************************************************************************
+ * FUNCTION IMPLEMENTATION
+ *****************************************************************************/
+
+void tick_init(void)
+{
+    WDTCTL = TICK_WDT;      // Interval mode, divider see clock.h
+    IE1 |= WDTIE;           // Enable the WDT interrupt
+}
+
+unsigned long tick_now(void)
+{
+    unsigned long t;
+
+    // A 32 bit read takes two instructions, keep the ISR out of it
+    unsigned short state = __get_interrupt_state();
+    __disable_interrupt();
+    t = ticks;
+    __set_interrupt_state(state);
+
+    return t;
+}
+
+#pragma vector = WDT_VECTOR
+__interrupt void WDT_ISR(void)
+{
+    ticks++;
+}
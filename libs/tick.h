@@ -0,0 +1,43 @@
+/***************************************************************************//**
+ * @file    tick.h
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   System tick header
+ *
+ * The watchdog runs as an interval timer and counts ticks in the
+ * background, so drivers can timestamp samples without a Timer_A.
+ ******************************************************************************/
+
+#ifndef LIBS_TICK_H_
+#define LIBS_TICK_H_
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+
+#include <msp430g2553.h>
+#include "./clock.h"
+
+/******************************************************************************
+ * CONSTANTS
+ *****************************************************************************/
+
+// TICK_US, the length of one tick, depends on the clock profile (clock.h)
+
+// Days until tick_now() wraps, rounded: 407 at TICK_US 8192, 204 at 4096,
+// 102 at 2048
+#define TICK_WRAP_DAYS  ((0x100000000ULL + 86400000000ULL / TICK_US / 2) \
+                         / (86400000000ULL / TICK_US))
+
+/******************************************************************************
+ * FUNCTION PROTOTYPES
+ *****************************************************************************/
+
+// Start the watchdog interval timer. Call after initMSP().
+void tick_init(void);
+
+// Number of ticks since tick_init(); wraps after TICK_WRAP_DAYS.
+unsigned long tick_now(void);
+
+#endif /* LIBS_TICK_H_ */
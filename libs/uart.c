@@ -15,6 +15,7 @@
 
 #include "./uart.h"
 #include "./interrupts.h"
+#include "./clock.h"
 #include "string.h"
 
 /******************************************************************************
@@ -24,7 +25,7 @@
 // Buffer type definition:
 typedef struct
 {
-    char data[BUFFER_SIZE];
+    char data[RX_BUFFER_SIZE];
     char start;
     char end;
     char error;
@@ -33,44 +34,172 @@ typedef struct
 // Ring buffer definition:
 Buffer_t ringBuffer = { .start = 0, .end = 0, .error = 0, };
 
+// Transmit queue, filled by serialWrite() and drained by uart_TXISR()
+typedef struct
+{
+    char data[TX_BUFFER_SIZE];
+    volatile unsigned char start;   // next byte to send, moved by the ISR
+    volatile unsigned char end;     // next free slot, moved by serialWrite
+} TxBuffer_t;
+
+TxBuffer_t txBuffer = { .start = 0, .end = 0, };
+
+char txPolicy = TX_POLICY_BLOCK;
+char txTruncated = 0;           // rest of the current frame is discarded
+volatile unsigned char txHold = TX_NO_SLOT;     // reserved slot, not sent yet
+char txError = 0;
+unsigned int txStalls = 0;
+
 // Echo flag definition:
 char echoBack = 0;
 
+// Command lines assembled by the RX ISR in ringBuffer.data, which raw
+// mode does not use meanwhile. The ISR writes the slot lineHead %
+// LINE_SLOTS and advances lineHead when the line is complete, the main
+// loop reads lineTail; both only ever count up.
+#define LINE_FULL       1       // slot still taken, the line is lost
+#define LINE_TOO_LONG   2       // handed over empty at the line end
+#define LINE_SLOT(n)    (ringBuffer.data + ((n) % LINE_SLOTS) * LINE_LEN)
+
+volatile unsigned char lineHead = 0;
+volatile unsigned char lineTail = 0;
+unsigned char lineLength = 0;   // characters in the line being assembled
+char lineDiscard = 0;           // skip to CR: LINE_FULL or LINE_TOO_LONG
+char lineMode = 0;
+
 /******************************************************************************
  * LOCAL FUNCTION PROTOTYPES
  *****************************************************************************/
-void uart_RXISR(void);
-void uart_TXISR(void);
+char txEnqueue(char tx);
+void lineReceive(char rx);
 
 /******************************************************************************
  * LOCAL FUNCTION IMPLEMENTATION
  *****************************************************************************/
 
+// Put one byte into the transmit queue and make sure the TX interrupt
+// is running. Returns 0 if the queue is full.
+char txEnqueue(char tx)
+{
+    unsigned char next = (txBuffer.end + 1) % TX_BUFFER_SIZE;
+
+    if (next == txBuffer.start)
+        return 0;
+
+    txBuffer.data[txBuffer.end] = tx;
+    txBuffer.end = next;
+    IE2 |= UCA0TXIE;
+    return 1;
+}
+
+// Line discipline, runs inside the RX ISR for every received byte
+void lineReceive(char rx)
+{
+    char *line = LINE_SLOT(lineHead);
+
+    // For Carriage return or enter ie '\r', and '\n'
+    if ((rx == '\r') || (rx == '\n'))
+    {
+        if (echoBack)
+        {
+            txEnqueue('\r');
+            txEnqueue('\n');
+        }
+        if (lineDiscard == LINE_TOO_LONG)
+        {
+            line[0] = 0;
+            lineHead++;
+        }
+        else if ((lineDiscard == 0) && (lineLength > 0))
+        {
+            line[lineLength] = 0;
+            lineHead++;
+        }
+        lineLength = 0;
+        lineDiscard = 0;
+        return;
+    }
+
+    // The slot is still occupied by an unread line, or the line was
+    // already too long: skip everything up to the next line end
+    if ((unsigned char) (lineHead - lineTail) >= LINE_SLOTS)
+    {
+        ringBuffer.error = SERIAL_RX_OVERFLOW;
+        lineDiscard = LINE_FULL;
+    }
+    if (lineDiscard)
+        return;
+
+    // For Backspace and Delete chars
+    if ((rx == 0x7F) || (rx == 0x08))
+    {
+        if (lineLength > 0)
+        {
+            lineLength--;
+            if (echoBack)
+            {
+                txEnqueue(0x08);
+                txEnqueue(' ');
+                txEnqueue(0x08);
+            }
+        }
+        return;
+    }
+
+    // Reported by the empty line it turns into, not as an overflow
+    if (lineLength >= LINE_LEN - 1)
+    {
+        lineDiscard = LINE_TOO_LONG;
+        return;
+    }
+
+    line[lineLength++] = rx;
+    if (echoBack)
+        txEnqueue(rx);
+}
+
 void uart_RXISR(void)
 {
+    char rx = UCA0RXBUF;
+
+    if (lineMode)
+    {
+        lineReceive(rx);
+        return;
+    }
 
 // Store the received byte in the serial buffer. Since we're using a
 // ringbuffer, we have to make sure that we only use RXBUFFERSIZE bytes.
-    ringBuffer.data[ringBuffer.end++] = UCA0RXBUF;
-    ringBuffer.end %= BUFFER_SIZE;
-// If enabled, print the received data back to user.
+    ringBuffer.data[ringBuffer.end++] = rx;
+    ringBuffer.end %= RX_BUFFER_SIZE;
+// If enabled, print the received data back to user. Queued like every
+// other byte; if the queue is full the echo is lost rather than waiting
+// inside the ISR.
     if (echoBack)
     {
-        while (!(IFG2 & UCA0TXIFG))
-            ;
-        UCA0TXBUF = UCA0RXBUF;
+        txEnqueue(rx);
     }
 // Check for an overflow and set the corresponding variable.
     if (ringBuffer.start == ringBuffer.end)
     {
-        ringBuffer.error = 1;
+        ringBuffer.error = SERIAL_RX_OVERFLOW;
     }
     //IFG2 &= ~UCB0RXIFG; // clear interrupt flag
 }
 
 void uart_TXISR(void)
 {
-// Not needed
+    if ((txBuffer.start != txBuffer.end) && (txBuffer.start != txHold))
+    {
+        UCA0TXBUF = txBuffer.data[txBuffer.start];
+        txBuffer.start = (txBuffer.start + 1) % TX_BUFFER_SIZE;
+    }
+    else
+    {
+        // Nothing left or at a reserved byte, stop the interrupt until
+        // serialWrite() or serialPatch() restarts it
+        IE2 &= ~UCA0TXIE;
+    }
 }
 
 /******************************************************************************
@@ -78,28 +207,119 @@ void uart_TXISR(void)
  *****************************************************************************/
 void uart_init( void)
 {
-
-    interrupts_mode_uart(uart_RXISR, uart_TXISR);
 //    uart_flag = 1;
 
-    P1SEL = BIT1 + BIT2;           // P1.1 = RXD, P1.2=TXD, set everything
-    P1SEL2 = BIT1 + BIT2;           // else as a normal GPIO.
+    P1SEL |= BIT1 + BIT2;           // P1.1 = RXD, P1.2=TXD, leave the
+    P1SEL2 |= BIT1 + BIT2;          // I2C pins P1.6/P1.7 alone.
     UCA0CTL1 |= UCSSEL_2;           // Use the SMCLK
-//    UCA0BR0 = 0x83;                  // Changed - 9600 Baud at 16 MHz
-//    UCA0BR1 = 0x06;                  // 9600 Baud at 16 MHz
-    UCA0BR0 = 104;                  // Changed - 9600 Baud at 1MHz
-    UCA0BR1 = 0;                   // 9600 Baud at 1MHz
-    UCA0MCTL = UCBRS0;              // Modulation UCBRSx = 1
+    UCA0BR0 = UART_BR0;             // UART_BAUD at CLOCK_HZ, see clock.h
+    UCA0BR1 = UART_BR1;
+    UCA0MCTL = UART_MCTL;           // Modulation UCBRSx
     UCA0CTL1 &= ~UCSWRST;           // Initialize USCI state machine
     IE2 |= UCA0RXIE;                // Enable USCI_A0 RX interrupt
 
+    if (txBuffer.start != txBuffer.end)
+        IE2 |= UCA0TXIE;            // Resume a queue left from before
+
     //__enable_interrupt();
 
 }
 
 void uart_disable()
 {
-    IE2 &= ~UCA0RXIE;
+    // Let everything queued go out before the interrupts are switched off
+    serialTxDrain();
+    IE2 &= ~(UCA0RXIE | UCA0TXIE);
+}
+
+void serialLineMode(char on)
+{
+    unsigned short state = __get_interrupt_state();
+    __disable_interrupt();
+
+    lineMode = on ? 1 : 0;
+    lineLength = 0;
+    lineDiscard = 0;
+    lineHead = lineTail = 0;
+    ringBuffer.start = ringBuffer.end = 0;
+
+    __set_interrupt_state(state);
+}
+
+char serialLineAvailable(void)
+{
+    return lineHead != lineTail;
+}
+
+char* serialLine(void)
+{
+    if (lineHead == lineTail)
+    {
+        return 0;
+    }
+    return LINE_SLOT(lineTail);
+}
+
+void serialLineDone(void)
+{
+    if (lineHead != lineTail)
+        lineTail++;
+}
+
+void serialTxPolicy(char policy)
+{
+    txPolicy = policy;
+}
+
+void serialFrameStart(void)
+{
+    txTruncated = 0;
+}
+
+unsigned char serialReserve(void)
+{
+    unsigned char slot = txBuffer.end;
+
+    // Hold the transmitter before the byte is visible to it
+    txHold = slot;
+    serialWrite(0);
+    if (txBuffer.end == slot)
+    {
+        txHold = TX_NO_SLOT;
+        return TX_NO_SLOT;
+    }
+    return slot;
+}
+
+void serialPatch(unsigned char slot, char value)
+{
+    if (slot == TX_NO_SLOT)
+        return;
+
+    txBuffer.data[slot] = value;
+    txHold = TX_NO_SLOT;
+    if (txBuffer.start != txBuffer.end)
+        IE2 |= UCA0TXIE;
+}
+
+unsigned char serialTxPending(void)
+{
+    return (txBuffer.end - txBuffer.start + TX_BUFFER_SIZE) % TX_BUFFER_SIZE;
+}
+
+void serialTxDrain(void)
+{
+    while (txBuffer.start != txBuffer.end)
+        ;
+    while (UCA0STAT & UCBUSY)
+        ;
+}
+
+unsigned int serialTxStalls(void)
+{
+    unsigned int r = txStalls;
+    txStalls = 0;
+    return r;
 }
 
 void serialEchoBack(char e)
@@ -115,21 +335,33 @@ void serialEchoBack(char e)
 
 char serialError()
 {
-    char r = ringBuffer.error;
+    char r = ringBuffer.error | txError;
     ringBuffer.error = 0;
+    txError = 0;
     return r;
 }
 
 void serialWrite(char tx)
 {
-    /* Loop until the TX buffer is ready.*/
-    while (!(IFG2 & UCA0TXIFG))
-        ;
-    /* Write the character into the TX-register */
-    UCA0TXBUF = tx;
-    /* And wait until it has been transmitted. */
-    while (!(IFG2 & UCA0TXIFG))
-        ;
+    /* The frame already lost a byte, drop the rest of it. */
+    if (txTruncated)
+        return;
+
+    /* Queue the character; the TX ISR sends it in the background. */
+    while (!txEnqueue(tx))
+    {
+        // Waiting cannot help while the queue is stuck at a reserved byte
+        if ((txPolicy == TX_POLICY_BLOCK) && (txBuffer.start != txHold))
+        {
+            txStalls++;
+            continue;
+        }
+
+        txError = SERIAL_TX_OVERFLOW;
+        if (txPolicy == TX_POLICY_TRUNCATE)
+            txTruncated = 1;
+        return;
+    }
 }
 
 void serialPrintInt(int i)
@@ -235,7 +467,7 @@ int serialRead(void)
     }
     // Save the first byte to a temporary variable, move the start-pointer
     char r = ringBuffer.data[ringBuffer.start++];
-    ringBuffer.start %= BUFFER_SIZE;
+    ringBuffer.start %= RX_BUFFER_SIZE;
     // and return the stored byte.
     return r;
 }
@@ -23,7 +23,25 @@
  * CONSTANTS
  *****************************************************************************/
 
-#define BUFFER_SIZE 32  // receive buffer array size
+// Longest command line including the terminating 0. The longest command
+// is "acc event transient off ths=127 count=255", 41 characters.
+#define LINE_LEN    42
+#define LINE_SLOTS  2   // complete lines waiting, must be a power of two
+
+// Receive buffer array size. In line mode the same array holds the lines.
+#define RX_BUFFER_SIZE  (LINE_SLOTS * LINE_LEN)
+#define TX_BUFFER_SIZE 32   // transmit queue size, one binary record fits
+
+// What serialWrite() does when the transmit queue is full
+#define TX_POLICY_BLOCK     0   // wait until the TX ISR has made room
+#define TX_POLICY_DROP      1   // discard the byte, keep the rest
+#define TX_POLICY_TRUNCATE  2   // discard the rest of the frame (see serialFrameStart)
+
+#define TX_NO_SLOT 0xFF     // serialReserve() could not queue the byte
+
+// serialError() bits
+#define SERIAL_RX_OVERFLOW  0x01    // received bytes or a whole line lost
+#define SERIAL_TX_OVERFLOW  0x02    // bytes not queued for sending
 
 
 /******************************************************************************
@@ -60,6 +78,84 @@
 void uart_disable(void);
 void uart_init( void);
 
+/**
+ * Switch the receiver to line mode (1) or back to the raw byte buffer (0).
+ * In line mode the RX ISR assembles whole command lines: backspace/delete
+ * remove the last character, CR or LF end the line, empty lines are
+ * ignored. A line longer than LINE_LEN - 1 characters is handed over
+ * empty, so it is rejected like any unknown command.
+ * serialAvailable()/serialRead() see no data in this mode. Both modes use
+ * the same buffer, switching discards what it holds.
+ *
+ * @param on    1 for line mode, 0 for raw mode
+ */
+void serialLineMode(char on);
+
+/**
+ * Returns 1 if at least one complete line is waiting, 0 if not.
+ */
+char serialLineAvailable(void);
+
+/**
+ * Returns the oldest complete line (without CR/LF, terminated by \0) or 0
+ * if no line is waiting. The line is used in place and stays valid until
+ * serialLineDone(). With all LINE_SLOTS taken the RX ISR drops the next
+ * line (serialError() reports it), so release it as soon as it is
+ * processed.
+ */
+char* serialLine(void);
+
+/**
+ * Remove the line returned by serialLine() from the queue.
+ */
+void serialLineDone(void);
+
+/**
+ * Select what happens when the transmit queue is full.
+ *
+ * @param policy    TX_POLICY_BLOCK (default), TX_POLICY_DROP or
+ *                  TX_POLICY_TRUNCATE.
+ */
+void serialTxPolicy(char policy);
+
+/**
+ * Mark the beginning of a new output frame. With TX_POLICY_TRUNCATE an
+ * overflow discards everything up to the next call of this function, so a
+ * frame is either sent up to a clean cut or not at all.
+ */
+void serialFrameStart(void);
+
+/**
+ * Queue a placeholder byte whose value is not known yet and return its
+ * slot, or TX_NO_SLOT if it was dropped. The transmitter stops in front
+ * of it until serialPatch() fills it in, so everything written meanwhile
+ * has to fit into the queue. Only one byte can be reserved at a time.
+ */
+unsigned char serialReserve(void);
+
+/**
+ * Fill in the byte reserved at <slot> and let the transmitter go on.
+ */
+void serialPatch(unsigned char slot, char value);
+
+/**
+ * Number of bytes still waiting in the transmit queue.
+ */
+unsigned char serialTxPending(void);
+
+/**
+ * Wait until the transmit queue is empty and the last byte has left the
+ * shift register.
+ */
+void serialTxDrain(void);
+
+/**
+ * Returns how often serialWrite() had to wait for free space since the
+ * last call, i.e. how long the caller was stalled by the serial link.
+ * Calling this function resets the counter.
+ */
+unsigned int serialTxStalls(void);
+
 
 /**
  * serialEchoBack
@@ -71,9 +167,12 @@ void serialEchoBack(char e);
 
 /**
  * This function can be used to check for an buffer-error such as a buffer
- * overflow. Calling this function will also reset the error-variable.
+ * overflow (receive or transmit side). Calling this function will also
+ * reset the error-variable.
  *
- * @return 0 if there is no error, anything elese if there is one.
+ * @return 0 if there is no error, otherwise SERIAL_RX_OVERFLOW and/or
+ *         SERIAL_TX_OVERFLOW. In line mode SERIAL_RX_OVERFLOW means a line
+ *         came in while all LINE_SLOTS were taken and was dropped.
  */
 char serialError(void);
 
@@ -81,6 +180,8 @@ char serialError(void);
  * Echo one character to the serial connection. Please note that this
  * function will not work with UTF-8-characters so you should stick
  * to ANSI or ASCII.
+ * The character is only queued; the TX interrupt sends it in the
+ * background. Must not be called with interrupts disabled.
  *
  * @param char The character to be displayed.
  */
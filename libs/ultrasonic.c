@@ -0,0 +1,357 @@
+/***************************************************************************//**
+ * @file    ultrasonic.c
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   Ultrasonic ranging on Timer1_A
+ *
+ * US-CLK   P3.3 (TA1.2) (shared) with I2C_SPI
+ * Rx-COMP  P1.0 (shared) with U_NTC
+ *
+ * P1.0 is no capture input, so the echo edge is captured in software:
+ * the port ISR toggles CCIS between GND and VCC, which latches TA1R.
+ ******************************************************************************/
+
+#include "./ultrasonic.h"
+#include "./tick.h"
+#include "./flash.h"
+#include "./interrupts.h"
+#include "./i2c.h"
+
+/******************************************************************************
+ * VARIABLES
+ *****************************************************************************/
+
+#define US_IDLE     0
+#define US_SETTLE   1
+#define US_BURST    2
+#define US_ECHO     3
+#define US_DONE     4
+
+volatile unsigned char us_state = US_IDLE;
+unsigned char us_pulses;        // burst periods sent
+unsigned char us_pings;         // pings of the running measurement
+unsigned char us_ping;          // the current one
+unsigned int us_echo[US_MAX_PINGS];     // 0: no echo
+unsigned long us_tick;          // first burst sent
+
+// Rate-of-change gate
+unsigned char us_tracking = 0;  // us_accepted is set
+unsigned char us_rejects;       // medians in a row outside the gate
+unsigned int us_accepted;
+unsigned long us_accepted_tick;
+
+// Calibration record in information segment D
+#define US_CAL_MAGIC    0x5543          // "US"
+#define US_CAL_RECORD   ((const us_cal_t *) FLASH_INFO_D)
+
+typedef struct
+{
+    unsigned int magic;
+    unsigned int scale;
+} us_cal_t;
+
+/******************************************************************************
+ * LOCAL FUNCTION PROTOTYPES
+ *****************************************************************************/
+
+void us_settle(unsigned int us);
+void us_pingDone(unsigned int echo);
+void us_finish(void);
+unsigned char us_gate(unsigned int echo, unsigned long tick);
+unsigned long us_roundTrip(unsigned int echo, int temperature);
+
+/******************************************************************************
+ * LOCAL FUNCTION IMPLEMENTATION
+ *****************************************************************************/
+
+// Wait <us> on CCR1 in continuous mode, the burst follows. CCR0 stays
+// without interrupt, its vector is the refresh timer's.
+void us_settle(unsigned int us)
+{
+    TA1CTL = TASSEL_2 + US_TIMER_ID + TACLR;
+    TA1CCTL2 = OUTMOD_0;
+    TA1CCR1 = us * US_COUNTS_PER_US;
+    TA1CCTL1 = CCIE;
+    us_state = US_SETTLE;
+    TA1CTL |= MC_2;
+}
+
+// Store the echo of the current ping (0 for none), then the next ping
+void us_pingDone(unsigned int echo)
+{
+    P1IE &= ~BIT0;
+    us_echo[us_ping] = echo;
+
+    if (++us_ping < us_pings)
+        us_settle(US_PING_GAP_US);
+    else
+        us_finish();
+}
+
+// Stop the timer and release the pins
+void us_finish(void)
+{
+    TA1CTL = TASSEL_2 + US_TIMER_ID;          // MC_0, stopped
+    TA1CCTL1 = 0;
+    TA1CCTL2 = 0;                             // OUTMOD_0, output low
+
+    // Pull-up and interrupt off for P1.0
+    P1IE &= ~BIT0;
+    P1IES &= ~BIT0;
+    P1IFG &= ~BIT0;
+    P1REN &= ~BIT0;
+    P1OUT &= ~BIT0;
+
+    // P3.3 is I/O again, at the level i2c_init() gave it
+    P3SEL &= ~BIT3;
+
+    us_state = US_DONE;
+}
+
+// 1 if <echo> is a plausible successor of the last accepted median
+unsigned char us_gate(unsigned int echo, unsigned long tick)
+{
+    unsigned long dt = tick - us_accepted_tick;
+    unsigned long limit;
+    unsigned int diff;
+
+    if (!us_tracking)
+        return 1;
+
+    // Beyond 8 s (at the slowest tick) the gate is wide open anyway
+    if (dt > 1000)
+        dt = 1000;
+    limit = (US_GATE_US + dt * TICK_US / 1000 * US_GATE_US_PER_S / 1000)
+            * US_COUNTS_PER_US;
+    diff = (echo > us_accepted) ? echo - us_accepted : us_accepted - echo;
+
+    return diff <= limit;
+}
+
+// Sound path of <echo> in mm, Q16, there and back
+unsigned long us_roundTrip(unsigned int echo, int temperature)
+{
+    // Speed of sound in mm/us, Q16: 331.3 m/s is 21712, 0.1 degC 3.972
+    unsigned int c = 21712 + (int) ((long) temperature * 3972 / 1000);
+
+    return (unsigned long) echo * c / US_COUNTS_PER_US;
+}
+
+/******************************************************************************
+ * FUNCTION IMPLEMENTATION
+ *****************************************************************************/
+
+unsigned char us_start(unsigned char pings)
+{
+    if (us_busy())
+        return 1;
+
+    if (pings < 1)
+        pings = 1;
+    if (pings > US_MAX_PINGS)
+        pings = US_MAX_PINGS;
+    us_pings = pings;
+    us_ping = 0;
+
+    // Hold the I2C queue and let a transfer on the bus finish, P3.3 is
+    // its enable
+    us_state = US_SETTLE;
+    while (i2c_busy())
+        i2c_service();
+
+    // Pull up for the R-COMP
+    P1IE &= ~BIT0;
+    P1REN |= BIT0;
+    P1OUT |= BIT0;
+
+    // Clock for US device from TA1.2, low until the burst. P3OUT keeps
+    // the I2C enable level for afterwards.
+    P3DIR |= BIT3;
+    TA1CCTL2 = OUTMOD_0;
+    P3SEL |= BIT3;
+
+    TA1CCTL0 = 0;
+    us_settle(US_SETTLE_US);
+
+    return 0;
+}
+
+unsigned char us_busy(void)
+{
+    return (us_state != US_IDLE) && (us_state != US_DONE);
+}
+
+unsigned char us_poll(us_result_t *result)
+{
+    unsigned int echo[US_MAX_PINGS];
+    unsigned int median, band, t;
+    unsigned char n = 0;
+    unsigned char agree = 0;
+    unsigned char i, j;
+
+    if (us_state != US_DONE)
+        return 0;
+
+    // Pings with an echo, sorted
+    for (i = 0; i < us_pings; i++)
+    {
+        t = us_echo[i];
+        if (t == 0)
+            continue;
+        for (j = n; (j > 0) && (echo[j - 1] > t); j--)
+            echo[j] = echo[j - 1];
+        echo[j] = t;
+        n++;
+    }
+    result->count = n;
+    us_state = US_IDLE;
+
+    if (n == 0)
+    {
+        result->valid = 0;
+        result->echo = 0;
+        result->confidence = 0;
+        return 1;
+    }
+
+    median = echo[(n - 1) / 2];
+    if ((n & 1) == 0)
+        median += (echo[n / 2] - median) / 2;
+
+    band = median >> 5;
+    if (band < US_AGREE_US * US_COUNTS_PER_US)
+        band = US_AGREE_US * US_COUNTS_PER_US;
+    for (i = 0; i < n; i++)
+        if ((echo[i] + band >= median) && (echo[i] <= median + band))
+            agree++;
+
+    result->valid = 1;
+    if (!us_gate(median, us_tick) && (++us_rejects < US_GATE_HOLD))
+    {
+        // Hold the last value, the next measurement decides
+        result->echo = us_accepted;
+        result->confidence = 0;
+        return 1;
+    }
+
+    us_rejects = 0;
+    us_tracking = 1;
+    us_accepted = median;
+    us_accepted_tick = us_tick;
+    result->echo = median;
+    result->confidence = agree * 100 / us_pings;
+    return 1;
+}
+
+void us_stop(void)
+{
+    unsigned short state = __get_interrupt_state();
+    __disable_interrupt();
+    if (us_busy())
+        us_finish();
+    us_state = US_IDLE;
+    __set_interrupt_state(state);
+}
+
+unsigned int us_millimetres(unsigned int echo, int temperature)
+{
+    // Half the round trip, Q16 to mm
+    unsigned long mm = (us_roundTrip(echo, temperature) + 0x10000) >> 17;
+
+    return (mm * us_calibration() + 0x4000) >> 15;
+}
+
+unsigned int us_calibration(void)
+{
+    if (US_CAL_RECORD->magic != US_CAL_MAGIC)
+        return US_CAL_DEFAULT;
+    return US_CAL_RECORD->scale;
+}
+
+void us_setCalibration(unsigned int scale)
+{
+    us_cal_t cal;
+
+    cal.magic = US_CAL_MAGIC;
+    cal.scale = scale;
+    flash_store(FLASH_INFO_D, &cal, sizeof(cal));
+}
+
+unsigned char us_calibrate(unsigned int echo, int temperature,
+                           unsigned int mm)
+{
+    // Uncalibrated distance in 1/16 mm
+    unsigned long raw = us_roundTrip(echo, temperature) >> 13;
+    unsigned long scale;
+
+    if ((raw == 0) || (mm > 4000))
+        return 1;
+    scale = (((unsigned long) mm << 19) + raw / 2) / raw;
+    if ((scale < US_CAL_MIN) || (scale > 0xFFFF))
+        return 1;
+
+    us_setCalibration(scale);
+    return 0;
+}
+
+#pragma vector = TIMER1_A1_VECTOR
+__interrupt void US_Timer(void)
+{
+    switch (TA1IV)
+    {
+    case TA1IV_TACCR1:
+        // Settled: burst in up mode, TA1.2 set at CCR2, reset at CCR0
+        TA1CTL = TASSEL_2 + US_TIMER_ID + TACLR;
+        TA1CCTL1 = 0;
+        TA1CCR0 = US_BURST_PERIOD_US * US_COUNTS_PER_US - 1;
+        TA1CCR2 = US_BURST_PERIOD_US * US_COUNTS_PER_US / 2;
+        TA1CCTL2 = OUTMOD_3;
+        us_pulses = 0;
+        if (us_ping == 0)
+            us_tick = tick_now();
+        us_state = US_BURST;
+        TA1CTL |= MC_1 + TAIE;
+        break;
+
+    case TA1IV_TAIFG:
+        // One period, the output was just reset
+        if (++us_pulses < US_BURST_PULSES)
+            break;
+
+        // Burst over: TA1R counts from here, capture on CCR1 with GND as
+        // CCS signal, the timeout as compare on CCR2 with the output low
+        TA1CCTL2 = OUTMOD_0;
+        TA1CTL = TASSEL_2 + US_TIMER_ID + TACLR;
+        TA1CCTL1 = CAP + CM_3 + CCIS_2;
+        TA1CCR2 = US_TIMEOUT_US * US_COUNTS_PER_US;
+        TA1CCTL2 = OUTMOD_0 + CCIE;
+
+        // High low edge of R-COMP
+        P1IFG &= ~BIT0;
+        P1IES |= BIT0;
+        P1IE |= BIT0;
+
+        us_state = US_ECHO;
+        TA1CTL |= MC_2;
+        break;
+
+    case TA1IV_TACCR2:
+        // No echo in time
+        us_pingDone(0);
+        break;
+    }
+}
+
+// R-COMP edge on P1.0, called by the port dispatcher (interrupts.c)
+void us_echoISR(void)
+{
+    P1IFG &= ~BIT0;
+    if (us_state != US_ECHO)
+        return;
+
+    // Toggle to get the signal value, TA1R is in TA1CCR1 then. An echo
+    // right at the end of the burst would read 0, count it as 1.
+    TA1CCTL1 ^= CCIS0;
+    us_pingDone(TA1CCR1 ? TA1CCR1 : 1);
+}
@@ -0,0 +1,114 @@
+/***************************************************************************//**
+ * @file    ultrasonic.h
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   Ultrasonic ranging header
+ *
+ * A measurement runs in the background on Timer1_A:
+ *
+ *   settle  P1.0 pull-up on, 1 ms until the comparator is quiet
+ *   burst   US_BURST_PULSES periods of 40 kHz on TA1.2 (P3.3), up mode
+ *   echo    continuous mode from the end of the burst; the first falling
+ *           edge on RX_COMP (P1.0) captures TA1R into TA1CCR1, TA1CCR2
+ *           ends the wait after US_TIMEOUT_US without an edge
+ *
+ * A measurement is a series of pings; the later ones start after
+ * US_PING_GAP_US, so the echoes of the previous one die down. us_start()
+ * returns at once and us_poll() hands over the result after the last ping:
+ * the median of the pings that got an echo, checked against the last
+ * accepted value by a rate-of-change gate. Timer1_A belongs to the
+ * measurement until then, so the refresh timer must be stopped. P3.3
+ * (I2C enable) and P1.0 (U_NTC) are shared, see main.c.
+ *
+ * us_millimetres() turns an echo into a distance with the speed of sound
+ * at the given temperature, 331.3 m/s + 0.606 m/s per degC, and a board
+ * calibration factor kept in information segment D.
+ ******************************************************************************/
+
+#ifndef LIBS_ULTRASONIC_H_
+#define LIBS_ULTRASONIC_H_
+
+/******************************************************************************
+ * INCLUDES
+ *****************************************************************************/
+
+#include <msp430g2553.h>
+#include "./clock.h"
+
+/******************************************************************************
+ * CONSTANTS
+ *****************************************************************************/
+
+#define US_SETTLE_US        1000
+#define US_BURST_PULSES     8
+#define US_BURST_PERIOD_US  25      // 40 kHz
+#define US_TIMEOUT_US       20000   // ~3.4 m there and back
+#define US_PING_GAP_US      4000    // settle time before further pings
+
+#define US_MAX_PINGS        5       // pings per measurement
+
+// A ping agrees with the median within 1/32 of it, at least US_AGREE_US
+#define US_AGREE_US         60
+
+// Rate-of-change gate: a median may differ from the last accepted one by
+// US_GATE_US plus US_GATE_US_PER_S per second in between (58 us per cm,
+// so 10 cm and 25 cm/s). It is accepted anyway once US_GATE_HOLD
+// measurements in a row failed, so a real step gets through.
+#define US_GATE_US          600
+#define US_GATE_US_PER_S    1500
+#define US_GATE_HOLD        2
+
+// Calibration factor in Q15 (32768 = 1.0) on top of the speed of sound.
+// The default is the former hand calibration, 52 instead of 58.2 us/cm.
+#define US_CAL_DEFAULT      36700
+#define US_CAL_MIN          16384   // 0.5, the maximum is 65535 (2.0)
+
+/******************************************************************************
+ * VARIABLES
+ *****************************************************************************/
+
+// One measurement
+typedef struct
+{
+    unsigned int echo;          // end of burst to echo, US_COUNTS_PER_US
+    unsigned char valid;        // 0: no ping got an echo
+    unsigned char count;        // pings that got an echo
+    unsigned char confidence;   // % of the pings agreeing with the median,
+                                // 0 if the gate held the last value
+} us_result_t;
+
+/******************************************************************************
+ * FUNCTION PROTOTYPES
+ *****************************************************************************/
+
+// Start a measurement of <pings> pings, 1 .. US_MAX_PINGS. Returns 1 if
+// one is still running, 0 otherwise.
+unsigned char us_start(unsigned char pings);
+
+// 1 while a measurement is running
+unsigned char us_busy(void);
+
+// Reduce the last measurement into <result> and return 1, once per
+// measurement; 0 if there is no new result. Outside of interrupts.
+unsigned char us_poll(us_result_t *result);
+
+// Abort a running measurement and release the timer and the pins.
+void us_stop(void);
+
+// Distance in mm for <echo> of a us_result_t at <temperature> in tenths of
+// degC
+unsigned int us_millimetres(unsigned int echo, int temperature);
+
+// Calibration factor in use, from flash or US_CAL_DEFAULT
+unsigned int us_calibration(void);
+
+// Store <scale> as calibration factor in flash.
+void us_setCalibration(unsigned int scale);
+
+// Store the factor that makes <echo> at <temperature> read as <mm>.
+// Returns 0 on success, 1 if it is out of range and nothing was stored.
+unsigned char us_calibrate(unsigned int echo, int temperature,
+                           unsigned int mm);
+
+#endif /* LIBS_ULTRASONIC_H_ */
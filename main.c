@@ -35,9 +35,10 @@
  * I2C_SPI     P3.3 (shared) with US_CLK
  * XSCL        P1.6
  * XSDA        P1.7
+ * MMA INT1    P1.5 (shared) with LED GREEN
  *
  * Actuators
- * LED GREEN    P1.5
+ * LED GREEN    P1.5 (shared) with MMA INT1
  * LED RED      P3.7
  * LED BLueX10  X3 (REL_ID)
  * REL_STAT     P3.4
@@ -59,45 +60,94 @@
 #include "libs/templateEMP.h"   // UART disabled, see @note!
 #include "string.h"
 #include "stdio.h"
+#include "stdlib.h"
 #include "libs/uart.h"
 #include "libs/sensor.h"
 #include "libs/adac.h"
 #include "libs/i2c.h"
 #include "libs/mma.h"
 #include "libs/lcd.h"
-
-int distance;
-double acc_values[3] = { 0, 0, 0 };
+#include "libs/tick.h"
+#include "libs/telemetry.h"
+#include "libs/ultrasonic.h"
+#include "libs/clock.h"
+
+us_result_t us_range;   // last ultrasonic measurement
+mma_accel_t acc_values = { 0, 0, 0 };  // cm/s^2
+// 8 bit, 4g, 100 Hz, normal oversampling, low noise off. Data-ready
+// sampling at 800 Hz takes ~60 % of the CPU at 1 MHz (mma.h).
+mma_session_t acc_session = { MMA_SESSION_CLOSED, 0, 1, MMA_ODR_100HZ,
+                              MMA_MODS_NORMAL, 0, 0 };
+char acc_stream = 0;    // MMA sampled on its data-ready interrupt
 int pot, ldr, ntc, pb;
+// Light classes with their lux bounds, each with a 30 % hysteresis band
+const char * const ldr_names[4] = { "Dark", "Low", "Medium", "High" };
+const sensor_bound_t ldr_bounds[3] = { { 10, 7 }, { 100, 70 }, { 700, 500 } };
+sensor_class_t ldr_class = { ldr_bounds, 4, 0 };
 char adc_values[5] = { 0, 0, 0, 0, 0 };
-
-char input[64];
-char cmd_stored[64];
-char input_cmd[64];
-char strmem_b[64];
-char led_array[6] = { 0, 0, 0, 0, 0, 0 };
-
-int flag = 0;
-double range = 0.0;
-int dboard_flag = 0;
-int time_counter = 0;
-int disp_flag = 0;
-int index = 0;
-int process_flag = 0;
-char check[3];
-int exit_dash = 0;
-int init_dash = 0;
-int user_mode = 1;
-int cmd_wrong = 0;
+i2c_txn_t joy_txn;      // ADAC read, runs while the other sensors are read
+
+char *cmd_stored = "";  // line being processed, in the UART's buffer
+char led_bits = 0;      // D1 in bit 0 ... D6 in bit 5
+
+char dboard_flag = 0;
+char time_counter = 0;
+char refresh_sub = 0;   // timer periods within the current 0.5 s
+char disp_flag = 0;
+char process_flag = 0;
+char exit_dash = 0;
+char init_dash = 0;
+char cmd_wrong = 0;
+
+// Output of every acquisition cycle: VT100 dashboard or binary records
+#define TELEMETRY_TEXT      0
+#define TELEMETRY_BINARY    1
+char telemetry_mode = TELEMETRY_TEXT;
+char refresh_ticks = 4; // refresh timer periods between acquisitions
+
+// Background analog sampling: per channel rate, decimation and averaging
+#define ADC_RATE_HZ     64      // 16 samples per result at 2 extra bits
+#define ADC_EXTRA_BITS  2
+#define ADC_AVG_SHIFT   2
+
+// Ultrasonic pings per measurement, reduced to their median
+#define US_PINGS        5
+
+// Dashboard value fields, in screen order
+#define DISP_RANGE      0
+#define DISP_ACC_X      1
+#define DISP_ACC_Y      2
+#define DISP_ACC_Z      3
+#define DISP_JOY_X      4
+#define DISP_JOY_Y      5
+#define DISP_POT        6
+#define DISP_LDR        7
+#define DISP_NTC        8
+#define DISP_PB1        9
+#define DISP_EVENT      15
+#define DISP_TEXT_LEN   20
+
+// Text fields up to DISP_NTC are remembered by a digest of their text, the
+// buttons and the event by their value.
+unsigned int disp_shadow[DISP_PB1];    // digest of the text on screen
+unsigned char disp_pb;  // buttons on screen
+char disp_redraw = 1;   // next frame sends every field
+char disp_footer = 1;   // next frame sends the help text
+char disp_sent = 0;     // something was sent in the current frame
+mma_event_t acc_last;   // last accelerometer event, type 0 if none yet
+char acc_last_shown = 0;
+
+void process_ldr();
+void disp_init();
 
 void relay_control()
 {
-    if (strcmp(cmd_stored, "relay on\r") == 0)
+    if (strcmp(cmd_stored, "relay on") == 0)
     {
         P3DIR |= BIT4;
         P3OUT |= BIT4;
     }
-    else if (strcmp(cmd_stored, "relay off\r") == 0)
+    else if (strcmp(cmd_stored, "relay off") == 0)
     {
         P3DIR |= BIT4;
         P3OUT &= ~BIT4;
@@ -153,40 +203,36 @@ void led_control()
     if ((strcmp(led, "led d6") == 0) || (strcmp(led, "led d5") == 0))
     {
 
-        if (strcmp(cmd_stored, "led d5 on\r") == 0)
+        if (strcmp(cmd_stored, "led d5 on") == 0)
         {
-            led_array[4] = 1;
+            led_bits |= BIT4;
 
         }
-        if (strcmp(cmd_stored, "led d5 off\r") == 0)
+        if (strcmp(cmd_stored, "led d5 off") == 0)
         {
-            led_array[4] = 0;
+            led_bits &= ~BIT4;
         }
-        if (strcmp(cmd_stored, "led d6 on\r") == 0)
+        if (strcmp(cmd_stored, "led d6 on") == 0)
         {
-            led_array[5] = 1;
+            led_bits |= BIT5;
         }
-        if (strcmp(cmd_stored, "led d6 off\r") == 0)
+        if (strcmp(cmd_stored, "led d6 off") == 0)
         {
-            led_array[5] = 0;
+            led_bits &= ~BIT5;
         }
 
-        // LED green 3.0  1.5
-        if (led_array[4] == 1)
-        {
-            P1DIR |= BIT5;
-            P1OUT |= BIT5;
-
-        }
-        else
+        // LED green 3.0  1.5, P1.5 may be MMA INT1 instead
+        if (!mma_intInUse())
         {
             P1DIR |= BIT5;
-            P1OUT &= ~BIT5;
-
+            if (led_bits & BIT4)
+                P1OUT |= BIT5;
+            else
+                P1OUT &= ~BIT5;
         }
 
         // LED red 3.1  3.7
-        if (led_array[5] == 1)
+        if (led_bits & BIT5)
         {
             P3DIR |= BIT7;
             P3OUT |= BIT7;
@@ -203,37 +249,37 @@ void led_control()
     else if ((strcmp(led, "led d1") == 0) || (strcmp(led, "led d2") == 0)
             || (strcmp(led, "led d3") == 0) || (strcmp(led, "led d4") == 0))
     {
-        if (strcmp(cmd_stored, "led d1 on\r") == 0)
+        if (strcmp(cmd_stored, "led d1 on") == 0)
         {
-            led_array[0] = 1;
+            led_bits |= BIT0;
         }
-        if (strcmp(cmd_stored, "led d1 off\r") == 0)
+        if (strcmp(cmd_stored, "led d1 off") == 0)
         {
-            led_array[0] = 0;
+            led_bits &= ~BIT0;
         }
-        if (strcmp(cmd_stored, "led d2 on\r") == 0)
+        if (strcmp(cmd_stored, "led d2 on") == 0)
         {
-            led_array[1] = 1;
+            led_bits |= BIT1;
         }
-        if (strcmp(cmd_stored, "led d2 off\r") == 0)
+        if (strcmp(cmd_stored, "led d2 off") == 0)
         {
-            led_array[1] = 0;
+            led_bits &= ~BIT1;
         }
-        if (strcmp(cmd_stored, "led d3 on\r") == 0)
+        if (strcmp(cmd_stored, "led d3 on") == 0)
         {
-            led_array[2] = 1;
+            led_bits |= BIT2;
         }
-        if (strcmp(cmd_stored, "led d3 off\r") == 0)
+        if (strcmp(cmd_stored, "led d3 off") == 0)
         {
-            led_array[2] = 0;
+            led_bits &= ~BIT2;
         }
-        if (strcmp(cmd_stored, "led d4 on\r") == 0)
+        if (strcmp(cmd_stored, "led d4 on") == 0)
         {
-            led_array[3] = 1;
+            led_bits |= BIT3;
         }
-        if (strcmp(cmd_stored, "led d4 off\r") == 0)
+        if (strcmp(cmd_stored, "led d4 off") == 0)
         {
-            led_array[3] = 0;
+            led_bits &= ~BIT3;
         }
 
         //shift_register_init();
@@ -242,7 +288,7 @@ void led_control()
         //clockReset();
         for (i = 3; i >= 0; i--)
         {
-            if (led_array[i] == 0)
+            if (!(led_bits & (1 << i)))
                 P2OUT &= ~BIT6;
             else
                 P2OUT |= BIT6;
@@ -260,33 +306,21 @@ void led_control()
 
 }
 
+// Into the first row of the framebuffer, lcd_task() shows it
 void write_to_lcd(char *s)
 {
-    delay_ms(50);
-    lcd_enable(1);
-
-    delay_ms(200);
-    lcd_cursorSet(1, 1);
-
-    delay_ms(200);
-    lcd_cursorShow(1);
-
-    delay_ms(1000);
-    lcd_putText(s);
+    lcd_fbLine(1, s);
 //
 //    delay_ms(1000);
 //    lcd_clear();
 }
 
+// The LCD was initialized by reset_actuators() when the dashboard started
 void lcd_control()
 {
-    lcd_init();
-    delay_ms(20);
 
     char lcd_cmd[10];
-    char text[32];
     memset(lcd_cmd, NULL, 10);
-    memset(text, NULL, 32);
     int i;
 
     for (i = 0; i <= 8; i++)
@@ -295,155 +329,447 @@ void lcd_control()
     if (strcmp(lcd_cmd, "lcd clear") == 0)
 
     {
-        lcd_clear();
-        delay_ms(10);
+        lcd_fbClear();
     }
 
     else if (strcmp(lcd_cmd, "lcd print") == 0)
     {
-        // handle if not needed
-        memcpy(text, &cmd_stored[10], 16);
+        // The text after "lcd print ", the LCD takes the first 16 characters
+        write_to_lcd((strlen(cmd_stored) > 10) ? cmd_stored + 10 : "");
+    }
+    else
+        cmd_wrong = 1;
+    //serialPrint("\e[1B\e[0E\e[2KWrong LCD command");
+
+}
+
+// Value of "<key>=" in the command line, 0 if it is not there
+const char* cmd_option(const char *key)
+{
+    const char *p = strstr(cmd_stored, key);
+
+    if (p == 0)
+        return 0;
+    p += strlen(key);
+    return (*p == '=') ? p + 1 : 0;
+}
+
+// "acc config odr=<Hz> mods=<normal|lnlp|hires|lp> lnoise=<0|1>", any
+// subset of the options. Returns 1 on an unknown value.
+int acc_config()
+{
+    // ODR in Hz, index is MMA_ODR_* (12 = 12.5, 6 = 6.25, 1 = 1.56 Hz)
+    static const int odr_hz[8] = { 800, 400, 200, 100, 50, 12, 6, 1 };
+    static const char * const mods_name[4] = { "normal", "lnlp", "hires",
+                                               "lp" };
+    mma_session_t next = acc_session;
+    const char *value;
+    int hz, i;
+
+    value = cmd_option("odr");
+    if (value)
+    {
+        hz = atoi(value);
+        for (i = 0; (i < 8) && (odr_hz[i] != hz); i++)
+            ;
+        if (i == 8)
+            return 1;
+        next.odr = i;
+    }
+
+    value = cmd_option("mods");
+    if (value)
+    {
+        for (i = 0; i < 4; i++)
+            if (strncmp(value, mods_name[i], strlen(mods_name[i])) == 0
+                    && (value[strlen(mods_name[i])] == ' '
+                            || value[strlen(mods_name[i])] == 0))
+                break;
+        if (i == 4)
+            return 1;
+        next.mods = i;
+    }
+
+    value = cmd_option("lnoise");
+    if (value)
+    {
+        if ((*value != '0') && (*value != '1'))
+            return 1;
+        next.lnoise = *value - '0';
+        if (next.lnoise && (next.range > 1))
+            return 1;
+    }
+
+    acc_session.odr = next.odr;
+    acc_session.mods = next.mods;
+    acc_session.lnoise = next.lnoise;
+
+    // A closed session picks the settings up when it opens
+    if (acc_session.state == MMA_SESSION_ACTIVE)
+        mma_configure(next.odr, next.mods, next.lnoise);
+    return 0;
+}
+
+// "acc event <motion|freefall|transient|orientation|tap> <on|off>
+// [ths=<0.063 g>] [count=<ODR periods>]"
+int acc_event()
+{
+    const char *value;
+    int ths = -1, count = -1;
+    int on;
+
+    if (strstr(cmd_stored, " on"))
+        on = 1;
+    else if (strstr(cmd_stored, " off"))
+        on = 0;
+    else
+        return 1;
+
+    value = cmd_option("ths");
+    if (value)
+        ths = atoi(value);
+    value = cmd_option("count");
+    if (value)
+        count = atoi(value);
+
+    if (strncmp(cmd_stored, "acc event motion", 16) == 0)
+        mma_setMotion(on ? MMA_AXES : 0, (ths < 0) ? 24 : ths,     // 1.5 g
+                      (count < 0) ? 2 : count, 0);
+    else if (strncmp(cmd_stored, "acc event freefall", 18) == 0)
+        mma_setMotion(on ? MMA_AXES : 0, (ths < 0) ? 3 : ths,      // 0.2 g
+                      (count < 0) ? 6 : count, 1);
+    else if (strncmp(cmd_stored, "acc event transient", 19) == 0)
+        mma_setTransient(on ? MMA_AXES : 0, (ths < 0) ? 8 : ths,   // 0.5 g
+                         (count < 0) ? 2 : count);
+    else if (strncmp(cmd_stored, "acc event orientation", 21) == 0)
+        mma_setOrientation(on, (count < 0) ? 10 : count);
+    else if (strncmp(cmd_stored, "acc event tap", 13) == 0)
+    {
+        if (on)
+            mma_enableTapInterrupt();
+        else
+            mma_disableTapInterrupt();
+    }
+    else
+        return 1;
+
+    return 0;
+}
+
+// Hand the accelerometer events on to telemetry or the dashboard
+void acc_events()
+{
+    mma_event_t event;
+    telemetry_event_t record;
+
+    mma_pollEvents();
+
+    while (mma_getEvent(&event))
+    {
+        if (telemetry_mode == TELEMETRY_BINARY)
+        {
+            record.tick = event.tick;
+            record.event = event.type;
+            record.src = event.src;
+            telemetry_sendEvent(&record);
+            continue;
+        }
+
+        // The dashboard shows the last one
+        acc_last = event;
+        acc_last_shown = 0;
+    }
+}
 
-        // Removing \r from string
-        int b = 0;
-        for (b = 0; b < 16; b++)
+void acc_control()
+{
+    if (strncmp(cmd_stored, "acc config", 10) == 0)
+    {
+        if (acc_config())
+            cmd_wrong = 1;
+    }
+    else if (strncmp(cmd_stored, "acc event", 9) == 0)
+    {
+        if ((acc_session.state != MMA_SESSION_ACTIVE) || acc_event())
+            cmd_wrong = 1;
+    }
+    else if (strcmp(cmd_stored, "acc stream on") == 0)
+    {
+        if ((acc_session.state == MMA_SESSION_ACTIVE) && !acc_stream)
         {
-            if (text[b] == '\r')
-                text[b] = NULL;
+            mma_dataReadyEnable();
+            acc_stream = 1;
         }
+    }
+    else if (strcmp(cmd_stored, "acc stream off") == 0)
+    {
+        if (acc_stream)
+        {
+            mma_dataReadyDisable();
+            acc_stream = 0;
+        }
+    }
+    else
+        cmd_wrong = 1;
+}
+
+// "us cal <mm>" with a target at <mm> in front of the sensor, or
+// "us cal reset" for the default calibration
+void us_control()
+{
+    int mm;
 
-        //char s[64] = { "Hello!" };
-        write_to_lcd(text);
+    if (strcmp(cmd_stored, "us cal reset") == 0)
+        us_setCalibration(US_CAL_DEFAULT);
+    else if (strncmp(cmd_stored, "us cal ", 7) == 0)
+    {
+        mm = atoi(cmd_stored + 7);
+        if (!us_range.valid || (mm <= 0)
+                || us_calibrate(us_range.echo, sensor_ntcTemperature(ntc),
+                                mm))
+            cmd_wrong = 1;
     }
     else
         cmd_wrong = 1;
-    //serialPrint("\e[1B\e[0E\e[2KWrong LCD command");
+}
 
+void telemetry_control()
+{
+    if (strcmp(cmd_stored, "telemetry binary") == 0)
+    {
+        // Records are ~30 bytes instead of a screen, sample every period
+        telemetry_mode = TELEMETRY_BINARY;
+        refresh_ticks = 1;
+    }
+    else if (strcmp(cmd_stored, "telemetry text") == 0)
+    {
+        telemetry_mode = TELEMETRY_TEXT;
+        refresh_ticks = 4;
+        disp_init();
+    }
+    else
+        cmd_wrong = 1;
 }
 
-void process_command()
+// Ultrasonic distance in mm: speed of sound at the board temperature,
+// calibrated for the sensor
+int range_millimetres()
 {
-    int j;
+    return us_millimetres(us_range.echo, sensor_ntcTemperature(ntc));
+}
 
-    for (j = 0; j < 3; j++)
-        check[j] = cmd_stored[j];
+void send_telemetry()
+{
+    telemetry_sample_t sample;
+
+    sample.tick = tick_now();
+    sample.range = us_range.valid ? range_millimetres() : -1;
+    sample.range_conf = us_range.confidence;
+    sample.range_count = us_range.count;
+    sample.acc[0] = acc_values.x;
+    sample.acc[1] = acc_values.y;
+    sample.acc[2] = acc_values.z;
+    sample.joy_x = adc_values[1];
+    sample.joy_y = adc_values[2];
+    sample.pot = pot;
+    sample.ldr = ldr;
+    sample.ntc = ntc;
+    sample.pb = pb;
+
+    telemetry_sendSample(&sample);
+}
 
-    if (strcmp(check, "led") == 0)
+void process_command()
+{
+    if (strncmp(cmd_stored, "led", 3) == 0)
         led_control();
 
-    else if (strcmp(check, "lcd") == 0)
+    else if (strncmp(cmd_stored, "lcd", 3) == 0)
         lcd_control();
 
-    else if (strcmp(check, "rel") == 0)
+    else if (strncmp(cmd_stored, "rel", 3) == 0)
         relay_control();
 
-    else if (strcmp(check, "exi") == 0)
+    else if (strncmp(cmd_stored, "exi", 3) == 0)
     {
         exit_dash = 1;
     }
+    else if (strncmp(cmd_stored, "red", 3) == 0)
+    {
+        // Nothing to redraw in binary mode
+        if (telemetry_mode == TELEMETRY_TEXT)
+            disp_init();
+    }
+
+    else if (strncmp(cmd_stored, "tel", 3) == 0)
+        telemetry_control();
+
+    else if (strncmp(cmd_stored, "acc", 3) == 0)
+        acc_control();
+
+    else if (strncmp(cmd_stored, "us ", 3) == 0)
+        us_control();
     else
         cmd_wrong = 1;
 
-    if (cmd_wrong == 1)
-    {
+    // In binary mode text would end up inside the current COBS frame
+    if ((cmd_wrong == 1) && (telemetry_mode == TELEMETRY_TEXT))
         serialPrint("Wrong Command. Follow Format");
-        cmd_wrong = 0;
-    }
-
-    memset(cmd_stored, NULL, 64);
+    cmd_wrong = 0;
 }
 
 void refresh_timer_start()
 {
 
-// Set mode for 0.5sec - SMCLK, divider -8, mode - up
+// Set mode for 0.5sec at 1 MHz - SMCLK, divider -8, mode - up
+// Faster clocks count REFRESH_POSTSCALE periods per 0.5 s in the ISR
+// Timer1 was the ultrasonic capture timer in between, set it up fully
     TA1CTL |= TACLR;
     TA1CTL = TASSEL_2 + ID_3;
     TA1CTL |= MC_1;
     TA1CCR0 = 62500;
-    TA1CCTL0 |= CCIE;
-    TA1CCTL0 &= ~CCIFG;
+    TA1CCTL0 = CCIE;
 
     time_counter = 0;
+    refresh_sub = 0;
 }
 
 void refresh_timer_stop()
 {
-    TA1CTL |= MC_0;  // Stop timer
+    TA1CTL &= ~MC_3;  // Stop timer
 }
 
-void us_timer_init(void)
+void get_joystick()
 {
-// CLK - SMCLK at 1MHz
-    TA0CTL |= TACLR;
-    TA0CTL = TASSEL_2;
-
-// Clear Interrupt flag
-    TA0CCTL0 &= ~CCIFG;
-
-// Capture mode , both rising and falling edge , with GND as CCS signal
-    TA0CCTL0 |= CAP + CM_3 + CCIS_2;
+    adac_init();
+    // Read all 4 channel values from ADAC, completes in the background
+    adac_readAsync(&joy_txn, (unsigned char*) adc_values);
 }
 
-void get_us_dist(void)
+void get_acceleration()
 {
+    mma_sample_t sample;
 
-    unsigned char pulse_count;
-// Clock for US device
-    P3DIR |= BIT3;
-    P3OUT &= ~BIT3;
-
-// Pull up for the R-COMP
-    P1REN |= BIT0;
-    P1OUT |= BIT0;
-
-// init timer
-    us_timer_init();
+    if (acc_stream)
+    {
+        // Samples arrive at the ODR, the newest one is shown
+        while (mma_getSample(&sample))
+            acc_values = sample.acc;
+    }
+    else
+        mma_sample(&acc_session, &acc_values);
 
-// Clear interrupt flag, high Low edge and enable
-    P1IFG &= ~BIT0;
-    P1IES |= BIT0;
-    P1IE |= BIT0;
+}
 
-// Stop capture timer
-//TA0CTL &= ~MC_2;
+// Characters sent for a dashboard field are remembered as a 16-bit digest,
+// not as text, which keeps the shadow screen at 2 bytes per field.
+unsigned int disp_digest(const char *text)
+{
+    unsigned int h = 5381;
+    while (*text)
+        h = (h << 5) + h + *text++;
+    return h;
+}
 
-// Wait for 1ms
-    __delay_cycles(1000);
+// Write a signed number as decimal text, returns the end of the string
+char* disp_itoa(char *dst, int value)
+{
+    char tmp[6];
+    unsigned int u = value;
+    int n = 0;
 
-// Start sending pulses with 40 KHz for the trigger
-    for (pulse_count = 0; pulse_count < 8; pulse_count++)
+    if (value < 0)
     {
-        P3OUT |= BIT3;
-        __delay_cycles(7);
-        P3OUT &= ~BIT3;
-        __delay_cycles(1);
+        *dst++ = '-';
+        u = -value;
     }
+    do
+    {
+        tmp[n++] = '0' + u % 10;
+        u /= 10;
+    }
+    while (u);
+    while (n)
+        *dst++ = tmp[--n];
+    *dst = 0;
+    return dst;
+}
 
-// Reset TAR
-    TA0CTL |= TACLR;
+// Move the cursor to field <field>, its text follows
+void disp_goto(unsigned char field)
+{
+    // Fields sit on every second row starting at row 3, column 24
+    serialPrint("\e[");
+    serialPrintInt(3 + 2 * field);
+    serialPrint(";24H ");
+    disp_sent = 1;
+}
 
-// Start capture timer
-    TA0CTL |= MC_2;
+// Send one value field, but only if its text differs from the last frame
+void disp_field(unsigned char field, const char *text)
+{
+    unsigned int digest = disp_digest(text);
 
-    __delay_cycles(10000);
+    if ((disp_redraw == 0) && (disp_shadow[field] == digest))
+        return;
+    disp_shadow[field] = digest;
 
+    disp_goto(field);
+    serialPrint((char*) text);
+    serialPrint("\e[0K");
 }
 
-void get_joystick()
+// Send the number <value> followed by <unit> as field <field>
+void disp_number(unsigned char field, int value, const char *unit)
 {
-    adac_init();
-    // Read all 4 channel values from ADAC
-    adac_read(adc_values);
+    char text[DISP_TEXT_LEN];
+
+    strcpy(disp_itoa(text, value), unit);
+    disp_field(field, text);
 }
 
-void get_acceleration()
+// <value> is in hundredths and printed with two decimals
+void disp_hundredths(unsigned char field, int value, const char *unit)
 {
-    mma_init();
-    acc_values[0] = mma_getRealX();
-    acc_values[1] = mma_getRealY();
-    acc_values[2] = mma_getRealZ();
+    char text[DISP_TEXT_LEN];
+    char *end = text;
+    unsigned int u = value;
 
+    if (value < 0)
+    {
+        *end++ = '-';
+        u = -value;
+    }
+    end = disp_itoa(end, u / 100);
+    *end++ = '.';
+    *end++ = '0' + (u % 100) / 10;
+    *end++ = '0' + u % 10;
+    strcpy(end, unit);
+    disp_field(field, text);
+}
+
+// <value> is in tenths and printed with one decimal
+void disp_tenths(unsigned char field, int value, const char *unit)
+{
+    char text[DISP_TEXT_LEN];
+    char *end = text;
+    unsigned int u = value;
+
+    if (value < 0)
+    {
+        *end++ = '-';
+        u = -value;
+    }
+    end = disp_itoa(end, u / 10);
+    *end++ = '.';
+    *end++ = '0' + u % 10;
+    strcpy(end, unit);
+    disp_field(field, text);
+}
+
+void disp_request_redraw()
+{
+    disp_redraw = 1;
 }
 
 void disp_init()
@@ -458,13 +784,17 @@ void disp_init()
     serialPrint("\e[13;0HJOystick Y: ");
     serialPrint("\e[15;0HPotentiometer : ");
     serialPrint("\e[17;0HLDR: ");
-    serialPrint("\e[19;0HNTC: ");
+    serialPrint("\e[19;0HNTC Temperature: ");
     serialPrint("\e[21;0HPB1: ");
     serialPrint("\e[23;0HPB2: ");
     serialPrint("\e[25;0HPB3: ");
     serialPrint("\e[27;0HPB4: ");
     serialPrint("\e[29;0HPB5: ");
     serialPrint("\e[31;0HPB6: ");
+    serialPrint("\e[33;0HAcceleration Event: ");
+
+    // The screen was cleared, the next frame has to send every field
+    disp_request_redraw();
 
 //serialPrint("\e[2;20H \e[K");
 //serialPrint("\e[H");
@@ -473,158 +803,226 @@ void disp_init()
 
 }
 
-void disp_value()
+// Range, confidence and pings with an echo, e.g. "42.5 cm 80% 4/5"
+void disp_range()
 {
+    char text[DISP_TEXT_LEN];
+    char *end;
+    int range_mm = range_millimetres();
 
-    serialPrint("\e[H");
-    serialPrint("\e[3;24H\e[0K ");
-    if ((range <= 1)) // || (range > 15))
+    if (!us_range.valid)
+    {
+        disp_field(DISP_RANGE, "No Echo");
+    }
+    else if ((range_mm <= 10)) // || (range > 15))
     {
-        serialPrint("Out of Range");
+        disp_field(DISP_RANGE, "Out of Range");
     }
     else
     {
-        serialPrintInt(range);
-        serialPrint(" cm");
+        end = disp_itoa(text, range_mm / 10);
+        *end++ = '.';
+        *end++ = '0' + range_mm % 10;
+        strcpy(end, " cm ");
+        end = disp_itoa(end + 4, us_range.confidence);
+        *end++ = '%';
+        *end++ = ' ';
+        end = disp_itoa(end, us_range.count);
+        *end++ = '/';
+        disp_itoa(end, US_PINGS);
+        disp_field(DISP_RANGE, text);
     }
+}
 
-    serialPrint("\e[5;24H\e[0K ");
-    serialPrintInt(acc_values[0]);
-    serialPrint(" m/s^2");
+// Lux and class, e.g. "120 lx Medium"
+void disp_ldr()
+{
+    char text[DISP_TEXT_LEN];
+    char *end;
 
-    serialPrint("\e[7;24H\e[0K ");
-    serialPrintInt(acc_values[1]);
-    serialPrint(" m/s^2");
+    end = disp_itoa(text, sensor_ldrLux(ldr));
+    strcpy(end, " lx ");
+    strcpy(end + 4, ldr_names[ldr_class.level]);
+    disp_field(DISP_LDR, text);
+}
 
-    serialPrint("\e[9;24H\e[0K ");
-    serialPrintInt(acc_values[2]);
-    serialPrint(" m/s^2");
+// Last accelerometer event with its source register and time in seconds,
+// e.g. "Tap 44 12 s"
+void disp_event()
+{
+    unsigned long seconds;
+    char tmp[10];
+    int n = 0;
 
-    serialPrint("\e[11;24H\e[0K ");
-    serialPrintInt(adc_values[1]);
+    if (acc_last_shown && (disp_redraw == 0))
+        return;
+    acc_last_shown = 1;
 
-    serialPrint("\e[13;24H\e[0K ");
-    serialPrintInt(adc_values[2]);
+    disp_goto(DISP_EVENT);
+    switch (acc_last.type)
+    {
+    case 0:
+        serialPrint("-\e[0K");
+        return;
+    case MMA_EVENT_MOTION:
+        serialPrint(mma_motionIsFreefall() ? "Freefall" : "Motion");
+        break;
+    case MMA_EVENT_TAP:
+        serialPrint("Tap");
+        break;
+    case MMA_EVENT_ORIENTATION:
+        serialPrint("Orientation");
+        break;
+    default:
+        serialPrint("Transient");
+        break;
+    }
 
-    serialPrint("\e[15;24H\e[0K ");
-    serialPrintInt(pot);
+    serialWrite(' ');
+    serialWrite("0123456789ABCDEF"[acc_last.src >> 4]);
+    serialWrite("0123456789ABCDEF"[acc_last.src & 0x0F]);
+    serialWrite(' ');
+    seconds = acc_last.tick / (1000000UL / TICK_US);
+    do
+    {
+        tmp[n++] = '0' + seconds % 10;
+        seconds /= 10;
+    }
+    while (seconds);
+    while (n)
+        serialWrite(tmp[--n]);
+    serialPrint(" s\e[0K");
+}
 
-    serialPrint("\e[17;24H\e[0K ");
-    process_ldr();
-//    serialPrintInt(ldr);
+// PB1 to PB6, each one that changed
+void disp_buttons()
+{
+    unsigned char i;
 
-    serialPrint("\e[19;24H\e[0K ");
-    serialPrintInt(ntc);
+    for (i = 0; i < 6; i++)
+    {
+        if ((disp_redraw == 0) && !((pb ^ disp_pb) & (1 << i)))
+            continue;
+        disp_goto(DISP_PB1 + i);
+        serialWrite(((pb >> i) & 0x01) ? '1' : '0');
+        serialPrint("\e[0K");
+    }
+    disp_pb = pb;
+}
 
-    serialPrint("\e[21;24H\e[0K ");
-    serialPrintInt(pb & 0x01);
+void disp_value()
+{
+    serialFrameStart();
+    disp_sent = 0;
 
-    serialPrint("\e[23;24H\e[0K ");
-    serialPrintInt((pb >> 1) & 0x01);
+    disp_range();
 
-    serialPrint("\e[25;24H\e[0K ");
-    serialPrintInt((pb >> 2) & 0x01);
+    disp_hundredths(DISP_ACC_X, acc_values.x, " m/s^2");
+    disp_hundredths(DISP_ACC_Y, acc_values.y, " m/s^2");
+    disp_hundredths(DISP_ACC_Z, acc_values.z, " m/s^2");
 
-    serialPrint("\e[27;24H\e[0K ");
-    serialPrintInt((pb >> 3) & 0x01);
+    disp_number(DISP_JOY_X, (unsigned char) adc_values[1], "");
+    disp_number(DISP_JOY_Y, (unsigned char) adc_values[2], "");
 
-    serialPrint("\e[29;24H\e[0K ");
-    serialPrintInt((pb >> 4) & 0x01);
+    disp_number(DISP_POT, pot, "");
 
-    serialPrint("\e[31;24H\e[0K ");
-    serialPrintInt((pb >> 5) & 0x01);
+    disp_ldr();
+//    serialPrintInt(ldr);
 
-    serialPrint("\e[33;0H\e[2KTo control - LED, LCD, RELAYS. Use below Format");
-    serialPrint(
-            "\e[34;0H\e[2KCommand Format - [Device] [Sub-Device] [Command] [Sub-Command]");
-    serialPrint("\e[35;0H\e[2K");
+    disp_tenths(DISP_NTC, sensor_ntcTemperature(ntc), " C");
 
-    serialPrint("\e[37;0H\e[2KEnter Command :");
+    disp_event();
+
+    disp_buttons();
+
+    // The help text only changes when the screen was cleared or when a
+    // command printed its response below it.
+    if (disp_redraw || disp_footer)
+    {
+        serialPrint("\e[35;0H\e[2KTo control - LED, LCD, RELAYS. Use below Format");
+        serialPrint(
+                "\e[36;0H\e[2KCommand Format - [Device] [Sub-Device] [Command] [Sub-Command]");
+        serialPrint("\e[37;0H\e[2K");
+
+        serialPrint("\e[39;0H\e[2KEnter Command :");
 //    serialPrint("\e[3;0H? ");
-    serialPrint("\e[38;0H\e[2K");
+        serialPrint("\e[40;0H\e[2K");
+        disp_footer = 0;
+    }
+    else if (disp_sent)
+    {
+        // Park the cursor on the input line again
+        serialPrint("\e[40;0H");
+    }
 
+    disp_redraw = 0;
 }
 
 void get_user_input()
 {
+    // Lines are assembled by the UART RX ISR and used in place, they are
+    // released by serialLineDone() once processed
+    char *line = serialLine();
 
-    while (serialAvailable() == 1)
+    // A line came in while all slots were taken
+    if ((serialError() & SERIAL_RX_OVERFLOW)
+            && (telemetry_mode == TELEMETRY_TEXT))
     {
-        if (serialAvailable() == 1)
-        {
-            char c = serialRead();
-            input_cmd[index] = c;
-
-            // For Backspace and Delete chars
-            if ((c == 0x7F) || (c == 0x08))
-            {
-                input_cmd[index] = NULL;
-                index--;
-                input_cmd[index] = NULL;
-                index--;
-            }
-
-            // For Carriage return or enter ie '\r'
-            if (c == 0x0D)
-            {
-                memset(cmd_stored, NULL, 64);
-                strcpy(cmd_stored, input_cmd);
-                serialPrint("\e[1B\e[0E\e[2KCommand Entered: ");
-                serialPrint(cmd_stored);
-                index = 0;
-                memset(input_cmd, NULL, 64);
-                process_flag = 1;
-                break;
-
-            }
-
-            index++;
+        serialPrint("\e[1B\e[0E\e[2KLine dropped, enter it again");
+        disp_footer = 1;
+    }
 
+    if (line)
+    {
+        cmd_stored = line;
+        if (telemetry_mode == TELEMETRY_TEXT)
+        {
+            serialPrint("\e[1B\e[0E\e[2KCommand Entered: ");
+            disp_footer = 1;
+            serialPrint(cmd_stored);
         }
+        process_flag = 1;
     }
 }
 
+// Convert the LDR to lux and update its light class. A class change is
+// sent as an event in binary mode.
 void process_ldr()
 {
-    if (ldr <= 100)
-        serialPrint("Low Intensity");
-    if ((ldr > 100) && (ldr <= 400))
-        serialPrint("Medium Intensity");
-    if ((ldr > 450))
-        serialPrint("High Intensity");
+    telemetry_event_t record;
+
+    if (!sensor_classify(&ldr_class, sensor_ldrLux(ldr)))
+        return;
+
+    if (telemetry_mode == TELEMETRY_BINARY)
+    {
+        record.tick = tick_now();
+        record.event = SENSOR_EVENT_LIGHT;
+        record.src = ldr_class.level;
+        telemetry_sendEvent(&record);
+    }
 }
 
 void get_sensor_readings()
 {
+    sensor_analog_t analog;     // NTC, LDR and U_POT of the last scan
 
-    refresh_timer_stop();
-
-    get_us_dist();
-    // Actual as per dataset 58 but calibrated for the sensor on board
-    range = distance / 52;
-
-    uart_disable();
-
+    // UART and I2C share the USCI interrupts but stay live side by side,
+    // commands typed now are still collected.
     get_joystick();
 
     get_acceleration();
 
-    delay_ms(100);
-
-    free_bus();
-
-    // I2C disable
-    P3OUT &= ~BIT3;
-
-    uart_init();
-
     sensor_init();
-    ntc = get_ntc();
-    ldr = get_ldr();
-
-    pot = get_pot();
+    sensor_readAnalog(&analog);
+    ntc = analog.ntc;
+    ldr = analog.ldr;
+    pot = analog.pot;
     pb = get_pb();
 
+    // Joystick values are in, the queue is empty
+    i2c_wait(&joy_txn);
+
     refresh_timer_start();
 
 }
@@ -637,38 +1035,38 @@ void reset_actuators()
     P3OUT &= ~BIT4;
 
     // shift leds off
-    int a;
-    for (a = 0; a <= 5; a++)
-        led_array[a] = 0;
+    led_bits = 0;
     shift_register_init();
 
-    // leds green and red
-    P1DIR |= BIT5;
-    P1OUT &= ~BIT5;
+    // leds green and red, P1.5 may be MMA INT1 instead
+    if (!mma_intInUse())
+    {
+        P1DIR |= BIT5;
+        P1OUT &= ~BIT5;
+    }
 
     P3DIR |= BIT7;
     P3OUT &= ~BIT7;
 
     lcd_init();
     lcd_clear();
-    delay_ms(30);
 
 }
 
 int main(void)
 {
     initMSP();
-    memset(input_cmd, NULL, 64);
-    memset(cmd_stored, NULL, 64);
-    memset(check, NULL, 3);
+    tick_init();
 
     uart_init();
+    serialLineMode(1);
 
-    index = 0;
     dboard_flag = 0;
 
     while (1)
     {
+        // Changed LCD cells, a few per tick
+        lcd_task();
 
         if (init_dash == 0)
         {
@@ -684,10 +1082,12 @@ int main(void)
             if (process_flag == 1)
             {
                 serialPrint(cmd_stored);
-                if ((strcmp(cmd_stored, "sensorDashboard\r") == 0)
+                if ((strcmp(cmd_stored, "sensorDashboard") == 0)
                         && (dboard_flag == 0))
                 {
                     dboard_flag = 1;
+                    sensor_startBackground(ADC_RATE_HZ, ADC_EXTRA_BITS,
+                                           ADC_AVG_SHIFT);
                     disp_init();
                     process_flag = 0;
                     reset_actuators();
@@ -700,6 +1100,7 @@ int main(void)
                     process_flag = 0;
                 }
                 process_flag = 0;
+                serialLineDone();
 
             }
         }
@@ -708,42 +1109,58 @@ int main(void)
         {
             dboard_flag = 2;
             disp_flag = 1;
-            time_counter = 4;
-            user_mode = 0;
+            time_counter = refresh_ticks;
 
         }
-        if ((disp_flag == 1) && (time_counter == 4))
+        // Timer1 is the ultrasonic timer until the measurement is over,
+        // P1.0 its RX_COMP instead of the NTC input.
+        if ((disp_flag == 1) && (time_counter == refresh_ticks))
+        {
+            refresh_timer_stop();
+            time_counter = 0;
+            sensor_hold(1);
+            us_start(US_PINGS);
+        }
+        if ((disp_flag == 1) && us_poll(&us_range))
         {
+            sensor_hold(0);
             get_sensor_readings();
+            acc_events();
+            process_ldr();
 
-            uart_init();
-
-            disp_value();
-
-            user_mode = 1;
+            if (telemetry_mode == TELEMETRY_BINARY)
+                send_telemetry();
+            else
+                disp_value();
 
         }
-        if ((disp_flag == 1) && (user_mode == 1))
+        // Commands are taken on every pass, measurement running or not;
+        // the RX ISR holds LINE_SLOTS lines while the loop is busy
+        while ((disp_flag == 1) && (exit_dash == 0) && serialLineAvailable())
         {
-            uart_init();
-
             get_user_input();
-            if (process_flag == 1)
-            {
-                process_command();
-                process_flag = 0;
-                user_mode = 0;
-            }
+            process_command();
+            process_flag = 0;
+            serialLineDone();
         }
 
         if (exit_dash == 1)
         {
             // Start over again
             exit_dash = 0;
+            telemetry_mode = TELEMETRY_TEXT;
+            refresh_ticks = 4;
+            us_stop();
+            sensor_hold(0);
+            sensor_stopBackground();
+            if (acc_stream)
+            {
+                mma_dataReadyDisable();
+                acc_stream = 0;
+            }
             init_dash = 0;
             disp_flag = 0;
             dboard_flag = 0;
-            user_mode = 0;
             reset_actuators();
             serialPrint("\e[0E\e[2KBoard Resetting...");
             serialPrint("\e[0EBoard Reset");
@@ -755,36 +1172,15 @@ int main(void)
 
 }
 
-# pragma vector = PORT1_VECTOR
-__interrupt
-void Port_1(void)
-{
-// Toggle to get the signal value
-    TA0CCTL0 ^= CCIS0;
-
-// Pullup disabled for P1.0
-    P1REN &= ~BIT0;
-    P1OUT &= ~BIT0;
-
-//disable interrupt
-    P1IES &= ~BIT0;
-    P1IE &= ~BIT0;
-
-// Stop Timer
-    TA0CTL &= ~MC_2;
-
-// Get the time
-    distance = TA0CCR0;
-
-// clear flag
-    P1IFG &= ~BIT0;
-
-}
-
 #pragma vector = TIMER1_A0_VECTOR
 __interrupt
 void Timer(void)
 {
+    TA1CCTL0 &= ~CCIFG;
+    if (++refresh_sub < REFRESH_POSTSCALE)
+        return;
+    refresh_sub = 0;
+
     time_counter++;
     if (time_counter > 4)
     {
@@ -792,5 +1188,4 @@ void Timer(void)
         //refresh_timer_stop();
         time_counter = 0;
     }
-    TA1CCTL0 &= ~CCIFG;
 }
@@ -0,0 +1,35 @@
+/***************************************************************************//**
+ * @file    check.h
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   Minimal checks for the host tests
+ *
+ * A failed CHECK() prints the condition and goes on, so one run shows all
+ * failures. main() ends with return check_done("name").
+ ******************************************************************************/
+
+#ifndef TESTS_CHECK_H_
+#define TESTS_CHECK_H_
+
+#include <stdio.h>
+
+static int check_failures = 0;
+
+#define CHECK(cond)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            check_failures++;                                               \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        }                                                                   \
+    } while (0)
+
+static inline int check_done(const char *name)
+{
+    printf("%s: %s\n", name, check_failures ? "FAILED" : "ok");
+    return check_failures ? 1 : 0;
+}
+
+#endif /* TESTS_CHECK_H_ */
@@ -0,0 +1,248 @@
+/***************************************************************************//**
+ * @file    msp430g2553.h
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   Register stand-in for the host tests
+ *
+ * Replaces the TI header when the drivers are built with gcc (see
+ * Makefile). Only what the tested drivers use is here, with the bit values
+ * of the real header. Every register is a plain variable that is reached
+ * through stub_access(), so a test can install stub_hook and play the
+ * peripheral behind it: the hook sees each access just before it happens.
+ * The interrupt intrinsics keep a GIE flag, stub_gie, and block SIGALRM
+ * while it is clear, so a test may raise "interrupts" from a timer signal.
+ * Setting GIE calls stub_hook with 0, the moment pending interrupts are
+ * taken.
+ ******************************************************************************/
+
+#ifndef TESTS_MSP430G2553_H_
+#define TESTS_MSP430G2553_H_
+
+/******************************************************************************
+ * REGISTER ACCESS
+ *****************************************************************************/
+
+#ifdef STUB_DEFINE
+#define STUB_EXTERN
+#else
+#define STUB_EXTERN extern
+#endif
+
+extern void (*stub_hook)(volatile void *reg);
+extern volatile unsigned char stub_gie;
+volatile void *stub_access(volatile void *reg);
+
+#define STUB_REG8(r)    (*(volatile unsigned char *) stub_access(&stub_##r))
+#define STUB_REG16(r)   (*(volatile unsigned short *) stub_access(&stub_##r))
+
+/******************************************************************************
+ * INTRINSICS
+ *****************************************************************************/
+
+#define __interrupt
+
+void __delay_cycles(unsigned long cycles);
+#define _delay_cycles __delay_cycles
+unsigned short __get_interrupt_state(void);
+void __set_interrupt_state(unsigned short state);
+void __disable_interrupt(void);
+void __enable_interrupt(void);
+
+/******************************************************************************
+ * BITS
+ *****************************************************************************/
+
+#define BIT0    0x0001
+#define BIT1    0x0002
+#define BIT2    0x0004
+#define BIT3    0x0008
+#define BIT4    0x0010
+#define BIT5    0x0020
+#define BIT6    0x0040
+#define BIT7    0x0080
+
+/******************************************************************************
+ * SPECIAL FUNCTION REGISTERS
+ *****************************************************************************/
+
+STUB_EXTERN volatile unsigned char stub_IE2;
+#define IE2             STUB_REG8(IE2)
+#define UCA0RXIE        0x01
+#define UCA0TXIE        0x02
+#define UCB0RXIE        0x04
+#define UCB0TXIE        0x08
+
+STUB_EXTERN volatile unsigned char stub_IFG2;
+#define IFG2            STUB_REG8(IFG2)
+#define UCA0RXIFG       0x01
+#define UCA0TXIFG       0x02
+#define UCB0RXIFG       0x04
+#define UCB0TXIFG       0x08
+
+/******************************************************************************
+ * WATCHDOG
+ *****************************************************************************/
+
+#define WDTPW           0x5A00
+#define WDTTMSEL        0x0010
+#define WDTCNTCL        0x0008
+#define WDTIS1          0x0002
+#define WDTIS0          0x0001
+#define WDT_MDLY_32     (WDTPW + WDTTMSEL + WDTCNTCL)           // SMCLK / 32768
+#define WDT_MDLY_8      (WDTPW + WDTTMSEL + WDTCNTCL + WDTIS0)  // SMCLK / 8192
+
+/******************************************************************************
+ * DIGITAL I/O
+ *****************************************************************************/
+
+STUB_EXTERN volatile unsigned char stub_P1DIR;
+STUB_EXTERN volatile unsigned char stub_P1OUT;
+STUB_EXTERN volatile unsigned char stub_P1SEL;
+STUB_EXTERN volatile unsigned char stub_P1SEL2;
+STUB_EXTERN volatile unsigned char stub_P2DIR;
+STUB_EXTERN volatile unsigned char stub_P2IN;
+STUB_EXTERN volatile unsigned char stub_P2OUT;
+STUB_EXTERN volatile unsigned char stub_P2SEL;
+STUB_EXTERN volatile unsigned char stub_P3DIR;
+STUB_EXTERN volatile unsigned char stub_P3IN;
+STUB_EXTERN volatile unsigned char stub_P3OUT;
+STUB_EXTERN volatile unsigned char stub_P3REN;
+#define P1DIR           STUB_REG8(P1DIR)
+#define P1OUT           STUB_REG8(P1OUT)
+#define P1SEL           STUB_REG8(P1SEL)
+#define P1SEL2          STUB_REG8(P1SEL2)
+#define P2DIR           STUB_REG8(P2DIR)
+#define P2IN            STUB_REG8(P2IN)
+#define P2OUT           STUB_REG8(P2OUT)
+#define P2SEL           STUB_REG8(P2SEL)
+#define P3DIR           STUB_REG8(P3DIR)
+#define P3IN            STUB_REG8(P3IN)
+#define P3OUT           STUB_REG8(P3OUT)
+#define P3REN           STUB_REG8(P3REN)
+
+/******************************************************************************
+ * TIMER0_A3
+ *****************************************************************************/
+
+STUB_EXTERN volatile unsigned short stub_TA0CTL;
+STUB_EXTERN volatile unsigned short stub_TA0CCTL1;
+STUB_EXTERN volatile unsigned short stub_TA0CCR0;
+STUB_EXTERN volatile unsigned short stub_TA0CCR1;
+#define TA0CTL          STUB_REG16(TA0CTL)
+#define TA0CCTL1        STUB_REG16(TA0CCTL1)
+#define TA0CCR0         STUB_REG16(TA0CCR0)
+#define TA0CCR1         STUB_REG16(TA0CCR1)
+
+#define TASSEL_2        0x0200      // SMCLK
+#define ID_0            0x0000      // input divider /1
+#define ID_1            0x0040
+#define ID_2            0x0080
+#define ID_3            0x00C0      // /8
+#define MC_0            0x0000      // stop
+#define MC_1            0x0010      // up to CCR0
+#define MC_3            0x0030      // up/down
+#define TACLR           0x0004
+#define OUTMOD_3        0x0060      // set/reset
+
+/******************************************************************************
+ * ADC10
+ *****************************************************************************/
+
+STUB_EXTERN volatile unsigned char stub_ADC10DTC0;
+STUB_EXTERN volatile unsigned char stub_ADC10DTC1;
+STUB_EXTERN volatile unsigned char stub_ADC10AE0;
+STUB_EXTERN volatile unsigned short stub_ADC10CTL0;
+STUB_EXTERN volatile unsigned short stub_ADC10CTL1;
+STUB_EXTERN volatile unsigned short stub_ADC10MEM;
+STUB_EXTERN volatile unsigned short stub_ADC10SA;
+#define ADC10DTC0       STUB_REG8(ADC10DTC0)
+#define ADC10DTC1       STUB_REG8(ADC10DTC1)
+#define ADC10AE0        STUB_REG8(ADC10AE0)
+#define ADC10CTL0       STUB_REG16(ADC10CTL0)
+#define ADC10CTL1       STUB_REG16(ADC10CTL1)
+#define ADC10MEM        STUB_REG16(ADC10MEM)
+#define ADC10SA         STUB_REG16(ADC10SA)
+
+#define ADC10SHT_2      0x1000      // 16 x ADC10CLK
+#define MSC             0x0080
+#define ADC10ON         0x0010
+#define ADC10IE         0x0008
+#define ADC10IFG        0x0004
+#define ENC             0x0002
+#define ADC10SC         0x0001
+
+#define INCH_0          0x0000
+#define INCH_3          0x3000
+#define INCH_4          0x4000
+#define SHS_1           0x0400      // Timer_A OUT1
+#define CONSEQ_1        0x0002      // sequence of channels
+#define CONSEQ_3        0x0006      // repeat sequence of channels
+#define ADC10BUSY       0x0001
+
+#define ADC10TB         0x08
+#define ADC10CT         0x04
+#define ADC10B1         0x02
+
+/******************************************************************************
+ * USCI_A0, UART MODE
+ *****************************************************************************/
+
+STUB_EXTERN volatile unsigned char stub_UCA0CTL1;
+STUB_EXTERN volatile unsigned char stub_UCA0BR0;
+STUB_EXTERN volatile unsigned char stub_UCA0BR1;
+STUB_EXTERN volatile unsigned char stub_UCA0MCTL;
+STUB_EXTERN volatile unsigned char stub_UCA0STAT;
+STUB_EXTERN volatile unsigned char stub_UCA0RXBUF;
+STUB_EXTERN volatile unsigned char stub_UCA0TXBUF;
+#define UCA0CTL1        STUB_REG8(UCA0CTL1)
+#define UCA0BR0         STUB_REG8(UCA0BR0)
+#define UCA0BR1         STUB_REG8(UCA0BR1)
+#define UCA0MCTL        STUB_REG8(UCA0MCTL)
+#define UCA0STAT        STUB_REG8(UCA0STAT)
+#define UCA0RXBUF       STUB_REG8(UCA0RXBUF)
+#define UCA0TXBUF       STUB_REG8(UCA0TXBUF)
+
+#define UCSSEL_2        0x80        // SMCLK
+#define UCSWRST         0x01
+#define UCBRS_MASK      0x0E        // UCA0MCTL, second stage modulation
+#define UCBUSY          0x01
+
+/******************************************************************************
+ * USCI_B0, I2C MODE
+ *****************************************************************************/
+
+STUB_EXTERN volatile unsigned char stub_UCB0CTL0;
+STUB_EXTERN volatile unsigned char stub_UCB0CTL1;
+STUB_EXTERN volatile unsigned char stub_UCB0BR0;
+STUB_EXTERN volatile unsigned char stub_UCB0BR1;
+STUB_EXTERN volatile unsigned char stub_UCB0I2CIE;
+STUB_EXTERN volatile unsigned char stub_UCB0STAT;
+STUB_EXTERN volatile unsigned char stub_UCB0RXBUF;
+STUB_EXTERN volatile unsigned char stub_UCB0TXBUF;
+STUB_EXTERN volatile unsigned short stub_UCB0I2CSA;
+#define UCB0CTL0        STUB_REG8(UCB0CTL0)
+#define UCB0CTL1        STUB_REG8(UCB0CTL1)
+#define UCB0BR0         STUB_REG8(UCB0BR0)
+#define UCB0BR1         STUB_REG8(UCB0BR1)
+#define UCB0I2CIE       STUB_REG8(UCB0I2CIE)
+#define UCB0STAT        STUB_REG8(UCB0STAT)
+#define UCB0RXBUF       STUB_REG8(UCB0RXBUF)
+#define UCB0TXBUF       STUB_REG8(UCB0TXBUF)
+#define UCB0I2CSA       STUB_REG16(UCB0I2CSA)
+
+#define UCMST           0x08        // UCB0CTL0
+#define UCMODE_3        0x06
+#define UCSYNC          0x01
+
+#define UCTR            0x10        // UCB0CTL1, UCSSEL_2 and UCSWRST above
+#define UCTXSTP         0x04
+#define UCTXSTT         0x02
+
+#define UCNACKIE        0x08        // UCB0I2CIE
+#define UCALIE          0x01
+
+#define UCNACKIFG       0x08        // UCB0STAT
+#define UCALIFG         0x01
+
+#endif /* TESTS_MSP430G2553_H_ */
@@ -0,0 +1,63 @@
+/***************************************************************************//**
+ * @file    stub.c
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   Registers and intrinsics of the host register stand-in
+ ******************************************************************************/
+
+#define STUB_DEFINE
+#include <signal.h>
+#include "msp430g2553.h"
+
+void (*stub_hook)(volatile void *reg) = 0;
+volatile unsigned char stub_gie = 0;    // cleared after reset, as on the chip
+
+volatile void *stub_access(volatile void *reg)
+{
+    if (stub_hook)
+        stub_hook(reg);
+    return reg;
+}
+
+void __delay_cycles(unsigned long cycles)
+{
+    (void) cycles;
+}
+
+unsigned short __get_interrupt_state(void)
+{
+    return stub_gie;
+}
+
+void __set_interrupt_state(unsigned short state)
+{
+    if (state)
+        __enable_interrupt();
+    else
+        __disable_interrupt();
+}
+
+void __disable_interrupt(void)
+{
+    sigset_t set;
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGALRM);
+    sigprocmask(SIG_BLOCK, &set, 0);
+    stub_gie = 0;
+}
+
+void __enable_interrupt(void)
+{
+    sigset_t set;
+
+    stub_gie = 1;
+    sigemptyset(&set);
+    sigaddset(&set, SIGALRM);
+    sigprocmask(SIG_UNBLOCK, &set, 0);
+
+    // Pending interrupts are taken now
+    if (stub_hook)
+        stub_hook(0);
+}
@@ -0,0 +1,97 @@
+/***************************************************************************//**
+ * @file    test_clock.c
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   Host test of the constants derived from the clock profile
+ *
+ * Built once per profile with -DCLOCK_PROFILE=1, 8 and 16. The UART
+ * settings are compared with the values the MSP430x2xx family guide
+ * recommends, everything else with the time or rate it stands for.
+ ******************************************************************************/
+
+#include "check.h"
+#include "../libs/clock.h"
+#include "../libs/tick.h"
+#include "../libs/i2c.h"
+
+// UCBRx and UCBRSx from the family guide, table "Commonly Used Baud Rates"
+#if CLOCK_PROFILE == 1
+#define GUIDE_BR    104
+#define GUIDE_BRS   1
+#elif CLOCK_PROFILE == 8
+#define GUIDE_BR    69
+#define GUIDE_BRS   4
+#else
+#define GUIDE_BR    138
+#define GUIDE_BRS   7
+#endif
+
+static double ratio(double value, double nominal)
+{
+    return value / nominal - 1.0;
+}
+
+static void test_uart(void)
+{
+    unsigned int br = UART_BR0 + 256 * UART_BR1;
+    unsigned int brs = (UART_MCTL & UCBRS_MASK) >> 1;
+    double baud = CLOCK_HZ * 8.0 / (8 * br + brs);
+
+    CHECK(UART_BAUD == CLOCK_BAUD);
+    CHECK(br == GUIDE_BR);
+    CHECK(brs == GUIDE_BRS);
+    CHECK(UART_MCTL == (UART_MCTL & UCBRS_MASK));
+    CHECK(ratio(baud, UART_BAUD) < 0.005 && ratio(baud, UART_BAUD) > -0.005);
+    printf("  UART  UCA0BR %u UCBRS %u: %.0f Baud for %lu\n", br, brs, baud,
+           (unsigned long) UART_BAUD);
+}
+
+static void test_i2c(void)
+{
+    unsigned int br = I2C_BR0 + 256 * I2C_BR1;
+    double scl = (double) CLOCK_HZ / br;
+
+    CHECK(br >= 4);
+    CHECK(scl <= I2C_HZ && scl <= 400000);
+    CHECK(ratio(scl, I2C_HZ) > -0.1);
+    printf("  I2C   UCB0BR %u: SCL %.0f Hz\n", br, scl);
+}
+
+static void test_timing(void)
+{
+    static const unsigned long wdt_div[4] = { 32768, 8192, 512, 64 };
+    unsigned long wdt = wdt_div[TICK_WDT & (WDTIS1 | WDTIS0)];
+    unsigned int us_div = 1 << ((US_TIMER_ID & ID_3) >> 6);
+    double flash_hz = (double) CLOCK_HZ / (FLASH_FN + 1);
+    // Timer1 in up mode to 62500 runs 62501 counts of SMCLK / 8
+    double refresh_s = REFRESH_POSTSCALE * 62501.0 * 8 / CLOCK_HZ;
+
+    CHECK(CLOCK_CYCLES_PER_US * 1000000UL == CLOCK_HZ);
+    CHECK(CLOCK_CYCLES_PER_MS * 1000UL == CLOCK_HZ);
+    CHECK(wdt == (unsigned long) TICK_US * CLOCK_MHZ);
+    CHECK(CLOCK_MHZ % us_div == 0);
+    CHECK(CLOCK_MHZ / us_div == US_COUNTS_PER_US);
+    CHECK(flash_hz >= 257000 && flash_hz <= 476000);
+    CHECK(ratio(refresh_s, 0.5) < 0.001 && ratio(refresh_s, 0.5) > -0.001);
+    CHECK(I2C_TIMEOUT_TICKS * TICK_US >= 50000UL);
+    CHECK(I2C_TIMEOUT_TICKS * TICK_US <= 70000UL);
+    printf("  tick  SMCLK / %lu: %u us\n", wdt, TICK_US);
+    printf("  timer ultrasonic /%u: %u counts per us\n", us_div,
+           US_COUNTS_PER_US);
+    printf("  flash %.0f Hz, refresh %.4f s, I2C timeout %lu us\n", flash_hz,
+           refresh_s, (unsigned long) (I2C_TIMEOUT_TICKS * TICK_US));
+}
+
+int main(void)
+{
+    char name[32];
+
+    printf("clock profile %d MHz\n", CLOCK_PROFILE);
+    test_uart();
+    test_i2c();
+    test_timing();
+
+    snprintf(name, sizeof(name), "test_clock_%d", CLOCK_PROFILE);
+    return check_done(name);
+}
@@ -0,0 +1,427 @@
+/***************************************************************************//**
+ * @file    test_i2c.c
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   Host test of the I2C transaction engine (libs/i2c.c)
+ *
+ * A model of USCI_B0 in master mode and of one slave runs behind the
+ * register stand-in. Every register access is one step of it: a byte
+ * (address or data) takes BYTE_STEPS steps on the bus, UCTXSTT, UCTXSTP,
+ * UCB0TXBUF and UCB0RXBUF act as in the family guide, and the flags raise
+ * i2c_RXISR() / i2c_TXISR() like the USCIAB0 dispatcher does. The slave
+ * is register based like the MMA8451: the first byte written sets the
+ * register pointer, reads continue from there.
+ *
+ * The test counts the bus phases and bytes of a reading done as separate
+ * transactions and as one i2c_write_read(), and covers a NACK on the
+ * address and on data, a lost arbitration and the STOP of a single byte
+ * read, which has to be requested while that byte is still coming in.
+ ******************************************************************************/
+
+#include <string.h>
+#include "check.h"
+#include "../libs/i2c.h"
+#include "../libs/interrupts.h"
+
+#define SLAVE_ADDR      0x1D
+#define BYTE_STEPS      8       // register accesses per byte on the bus
+#define STEPS_PER_TICK  1000
+
+#define SHIFT_NONE      0
+#define SHIFT_ADDRESS   1
+#define SHIFT_WRITE     2
+#define SHIFT_READ      3
+
+// What the slave does with the next transactions
+typedef struct
+{
+    unsigned char nackAddr;     // NACK the address
+    unsigned char nackByte;     // NACK this data byte (1 = first), 0 none
+    unsigned char arbLost;      // another master wins the next START
+} slave_t;
+
+// What went over the bus
+typedef struct
+{
+    unsigned int starts;
+    unsigned int restarts;
+    unsigned int stops;
+    unsigned int addrs;
+    unsigned int written;
+    unsigned int read;
+} bus_t;
+
+static slave_t slave;
+static bus_t bus;
+static unsigned char regs[0x32];        // slave registers
+static unsigned char pointer;           // slave register pointer
+
+static unsigned char shift;             // SHIFT_*, byte on the wire
+static unsigned char left;              // steps until it is through
+static unsigned char shiftByte;
+static unsigned char owned;             // START sent, no STOP yet
+static unsigned char nacked;            // slave refused, only STOP helps
+static unsigned char txMode;
+static unsigned char txFull;            // UCB0TXBUF written, not sent
+static unsigned char rxFull;            // UCB0RXBUF not read yet
+static unsigned char wIndex;            // data bytes of this transfer
+static unsigned char txWritten;         // accesses seen by the hook
+static unsigned char rxRead;
+static unsigned char inIsr;
+static unsigned long steps;
+
+/******************************************************************************
+ * BUS MODEL
+ *****************************************************************************/
+
+static void bus_reset(void)
+{
+    owned = nacked = txFull = rxFull = 0;
+    shift = SHIFT_NONE;
+    stub_UCB0CTL1 &= ~(UCTXSTT | UCTXSTP);
+    stub_UCB0STAT = 0;
+    stub_UCB0I2CIE = 0;
+    stub_IFG2 &= ~(UCB0TXIFG | UCB0RXIFG);
+    stub_IE2 &= ~(UCB0TXIE | UCB0RXIE);
+}
+
+static void bus_address(void)
+{
+    txMode = (stub_UCB0CTL1 & UCTR) ? 1 : 0;
+    txFull = 0;
+    wIndex = 0;
+    shift = SHIFT_ADDRESS;
+    left = BYTE_STEPS;
+    bus.addrs++;
+    // The first byte can be written as soon as the START is out
+    if (txMode)
+        stub_IFG2 |= UCB0TXIFG;
+}
+
+static void bus_stop(void)
+{
+    bus.stops++;
+    owned = nacked = 0;
+    stub_UCB0CTL1 &= ~UCTXSTP;
+}
+
+static void bus_nack(void)
+{
+    nacked = 1;
+    stub_UCB0STAT |= UCNACKIFG;
+}
+
+// The byte on the wire is through
+static void bus_shifted(void)
+{
+    switch (shift)
+    {
+    case SHIFT_ADDRESS:
+        stub_UCB0CTL1 &= ~UCTXSTT;
+        if (slave.nackAddr || (stub_UCB0I2CSA != SLAVE_ADDR))
+            bus_nack();
+        break;
+
+    case SHIFT_WRITE:
+        if (++wIndex == slave.nackByte)
+            bus_nack();
+        else if (wIndex == 1)
+            pointer = shiftByte;
+        else
+            regs[pointer++ % sizeof(regs)] = shiftByte;
+        break;
+
+    case SHIFT_READ:
+        stub_UCB0RXBUF = regs[pointer++ % sizeof(regs)];
+        bus.read++;
+        rxFull = 1;
+        stub_IFG2 |= UCB0RXIFG;
+        // A STOP requested during the byte NACKs it and ends the transfer
+        if (stub_UCB0CTL1 & UCTXSTP)
+            bus_stop();
+        break;
+    }
+    shift = SHIFT_NONE;
+}
+
+// Nothing on the wire: see what the master asks for next
+static void bus_next(void)
+{
+    unsigned char ctl1 = stub_UCB0CTL1;
+
+    if (!owned)
+    {
+        if (!(ctl1 & UCTXSTT) || !(stub_UCB0CTL0 & UCMST))
+            return;
+
+        bus.starts++;
+        if (slave.arbLost)
+        {
+            // The USCI drops into slave mode, as on the chip
+            slave.arbLost = 0;
+            stub_UCB0CTL1 &= ~UCTXSTT;
+            stub_UCB0CTL0 &= ~UCMST;
+            stub_UCB0STAT |= UCALIFG;
+            return;
+        }
+        owned = 1;
+        bus_address();
+        return;
+    }
+
+    if (nacked)
+    {
+        if (ctl1 & UCTXSTP)
+            bus_stop();
+        return;
+    }
+
+    if (txMode && txFull)
+    {
+        shiftByte = stub_UCB0TXBUF;
+        txFull = 0;
+        stub_IFG2 |= UCB0TXIFG;
+        shift = SHIFT_WRITE;
+        left = BYTE_STEPS;
+        bus.written++;
+    }
+    else if (ctl1 & UCTXSTT)
+    {
+        bus.restarts++;
+        bus_address();
+    }
+    else if (txMode && (ctl1 & UCTXSTP))
+    {
+        bus_stop();
+    }
+    else if (!txMode && !rxFull)
+    {
+        // The master clocks the next byte in once UCB0RXBUF is free
+        shift = SHIFT_READ;
+        left = BYTE_STEPS;
+    }
+}
+
+// USCIAB0RX before USCIAB0TX, GIE cleared inside like on the chip
+static void bus_dispatch(void)
+{
+    if (!stub_gie || inIsr)
+        return;
+
+    inIsr = 1;
+    stub_gie = 0;
+    if (stub_UCB0STAT & stub_UCB0I2CIE & (UCNACKIFG | UCALIFG))
+        i2c_RXISR();
+    if (stub_IFG2 & stub_IE2 & (UCB0TXIFG | UCB0RXIFG))
+        i2c_TXISR();
+    stub_gie = 1;
+    inIsr = 0;
+}
+
+static void bus_step(void)
+{
+    steps++;
+    if (stub_UCB0CTL1 & UCSWRST)
+    {
+        bus_reset();
+        return;
+    }
+
+    // Register accesses of the previous steps
+    if (txWritten)
+    {
+        txWritten = 0;
+        txFull = 1;
+        stub_IFG2 &= ~UCB0TXIFG;
+    }
+    if (rxRead)
+    {
+        rxRead = 0;
+        rxFull = 0;
+        stub_IFG2 &= ~UCB0RXIFG;
+    }
+
+    if (shift != SHIFT_NONE)
+    {
+        if (--left == 0)
+            bus_shifted();
+    }
+    else
+    {
+        bus_next();
+    }
+    bus_dispatch();
+}
+
+// Called just before the access, which therefore counts from the next step
+static void bus_hook(volatile void *reg)
+{
+    bus_step();
+    if (reg == &stub_UCB0TXBUF)
+        txWritten = 1;
+    else if (reg == &stub_UCB0RXBUF)
+        rxRead = 1;
+}
+
+/******************************************************************************
+ * DEPENDENCIES OF I2C.C
+ *****************************************************************************/
+
+// Time passes while i2c_wait() polls
+unsigned long tick_now(void)
+{
+    bus_step();
+    return steps / STEPS_PER_TICK;
+}
+
+unsigned char us_busy(void)
+{
+    return 0;
+}
+
+/******************************************************************************
+ * TESTS
+ *****************************************************************************/
+
+static unsigned char run(unsigned char wlen, const unsigned char *wbuf,
+                         unsigned char rlen, unsigned char *rbuf)
+{
+    i2c_txn_t txn = { 0 };
+
+    txn.addr = SLAVE_ADDR;
+    txn.wlen = wlen;
+    txn.wbuf = wbuf;
+    txn.rlen = rlen;
+    txn.rbuf = rbuf;
+    CHECK(i2c_submit(&txn) == I2C_PENDING);
+    return i2c_wait(&txn);
+}
+
+static void bus_clear(void)
+{
+    memset(&bus, 0, sizeof(bus));
+    memset(&slave, 0, sizeof(slave));
+}
+
+static void print_bus(const char *what)
+{
+    printf("  %-34s %u START, %u repeated START, %u STOP, %u bytes\n", what,
+           bus.starts, bus.restarts, bus.stops,
+           bus.addrs + bus.written + bus.read);
+}
+
+// One three-axis reading, OUT_X_MSB .. OUT_Z_LSB
+static void test_reading(void)
+{
+    unsigned char reg = 0x01;
+    unsigned char xyz[6];
+    bus_t separate;
+
+    printf("three-axis reading:\n");
+
+    bus_clear();
+    memset(xyz, 0, sizeof(xyz));
+    CHECK(i2c_write(1, &reg, 1) == 0);
+    i2c_read(6, xyz);
+    CHECK(memcmp(xyz, regs + 1, 6) == 0);
+    print_bus("i2c_write() + i2c_read()");
+    separate = bus;
+
+    bus_clear();
+    memset(xyz, 0, sizeof(xyz));
+    CHECK(i2c_write_read(1, &reg, 6, xyz) == 0);
+    CHECK(memcmp(xyz, regs + 1, 6) == 0);
+    print_bus("i2c_write_read()");
+
+    CHECK(bus.starts == 1 && bus.restarts == 1 && bus.stops == 1);
+    CHECK(bus.addrs == 2 && bus.written == 1 && bus.read == 6);
+    CHECK(separate.starts == 2 && separate.stops == 2);
+    CHECK(separate.addrs + separate.written + separate.read
+          == bus.addrs + bus.written + bus.read);
+    CHECK(!owned);
+}
+
+// The STOP has to be set while the only byte comes in, or the slave is
+// clocked for a second one
+static void test_single_byte(void)
+{
+    unsigned char reg = 0x0D;
+    unsigned char value = 0;
+
+    bus_clear();
+    CHECK(i2c_write_read(1, &reg, 1, &value) == 0);
+    CHECK(value == regs[0x0D]);
+    CHECK(bus.read == 1 && bus.stops == 1);
+
+    bus_clear();
+    pointer = 0x0D;
+    value = 0;
+    i2c_read(1, &value);
+    CHECK(value == regs[0x0D]);
+    CHECK(bus.read == 1 && bus.stops == 1);
+    CHECK(!owned);
+}
+
+static void test_nack(void)
+{
+    unsigned char reg = 0x01;
+    unsigned char data[3] = { 0x2A, 0x01, 0x02 };
+    unsigned char xyz[6];
+
+    // Nobody answers the address
+    bus_clear();
+    slave.nackAddr = 1;
+    CHECK(run(1, &reg, 6, xyz) == I2C_ERR_NACK);
+    CHECK(bus.written == 0 && bus.read == 0 && bus.stops == 1);
+    CHECK(!owned);
+
+    // The slave refuses the second byte, the third is not sent
+    bus_clear();
+    slave.nackByte = 2;
+    CHECK(i2c_write(3, data, 1) == 1);
+    CHECK(bus.written == 2 && bus.stops == 1);
+    CHECK(!owned);
+
+    // The bus works again afterwards
+    bus_clear();
+    CHECK(run(1, &reg, 6, xyz) == I2C_OK);
+    CHECK(memcmp(xyz, regs + 1, 6) == 0);
+}
+
+static void test_arbitration(void)
+{
+    unsigned char reg = 0x01;
+    unsigned char xyz[6];
+
+    bus_clear();
+    slave.arbLost = 1;
+    CHECK(run(1, &reg, 6, xyz) == I2C_ERR_ARBLOST);
+    CHECK(!owned);
+
+    // The next transaction has to run as master again
+    bus_clear();
+    memset(xyz, 0, sizeof(xyz));
+    CHECK(run(1, &reg, 6, xyz) == I2C_OK);
+    CHECK(memcmp(xyz, regs + 1, 6) == 0);
+    CHECK(bus.starts == 1 && bus.stops == 1);
+}
+
+int main(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(regs); i++)
+        regs[i] = 0x40 + i;
+
+    stub_hook = bus_hook;
+    i2c_init(SLAVE_ADDR);
+    __enable_interrupt();
+
+    test_reading();
+    test_single_byte();
+    test_nack();
+    test_arbitration();
+
+    return check_done("test_i2c");
+}
@@ -0,0 +1,109 @@
+/***************************************************************************//**
+ * @file    test_sensor.c
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   Host test of the NTC and LDR conversions (libs/sensor.c)
+ *
+ * Runs sensor_ntcTemperature() and sensor_ldrLux() as compiled from
+ * libs/sensor.c for every ADC code and compares them with the exact
+ * curves, evaluated in double from the parameters that
+ * tools/gen_tables.py wrote into the table headers. sensor.c is included
+ * rather than linked, as the headers define the tables and are only meant
+ * for one translation unit.
+ ******************************************************************************/
+
+#include <math.h>
+#include "check.h"
+#include "../libs/sensor.c"
+
+#define ADC_MAX 1023
+
+static double ntc_celsius(unsigned int adc)
+{
+    double r;
+    double t;
+
+    if (adc == 0)
+        return NTC_T_MAX;
+    r = NTC_R_FIXED * adc / (1024.0 - adc);
+    t = 1.0 / (1.0 / 298.15 + log(r / NTC_R25) / NTC_BETA) - 273.15;
+    return fmin(fmax(t, NTC_T_MIN), NTC_T_MAX);
+}
+
+static double ldr_lux(unsigned int adc)
+{
+    double r;
+
+    if (adc == 0)
+        return 0.0;
+    r = LDR_R_FIXED * (1024.0 - adc) / adc;
+    return fmin(10.0 * pow(r / LDR_R10, -1.0 / LDR_GAMMA), LDR_LUX_MAX);
+}
+
+// Largest error per temperature band. The clamped ends are not meant to
+// be exact.
+static void test_ntc(void)
+{
+    static const int bands[][2] = { { -40, 0 }, { 0, 60 }, { 60, 100 },
+                                    { 100, 150 } };
+    double worst[4] = { 0 };
+    unsigned int adc;
+    unsigned int i;
+
+    for (adc = 0; adc <= ADC_MAX; adc++)
+    {
+        double exact = ntc_celsius(adc);
+        double err = fabs(sensor_ntcTemperature(adc) / 10.0 - exact);
+
+        if ((exact <= NTC_T_MIN) || (exact >= NTC_T_MAX))
+            continue;
+        CHECK(err <= NTC_TOLERANCE);
+        for (i = 0; i < 4; i++)
+            if ((bands[i][0] < exact) && (exact < bands[i][1]))
+                worst[i] = fmax(worst[i], err);
+    }
+    CHECK(sensor_ntcTemperature(0xFFFF) == sensor_ntcTemperature(ADC_MAX));
+
+    for (i = 0; i < 4; i++)
+        printf("  NTC %4d .. %3d degC: max error %.2f degC\n", bands[i][0],
+               bands[i][1], worst[i]);
+}
+
+// Largest error per light band: in lux where the absolute tolerance
+// applies, relative above
+static void test_ldr(void)
+{
+    const double split = LDR_TOLERANCE_LUX / LDR_TOLERANCE;
+    double worst_lux = 0;
+    double worst_rel = 0;
+    unsigned int adc;
+
+    for (adc = 0; adc <= ADC_MAX; adc++)
+    {
+        double exact = ldr_lux(adc);
+        double err = fabs(sensor_ldrLux(adc) - exact);
+
+        CHECK(err <= fmax(LDR_TOLERANCE_LUX, LDR_TOLERANCE * exact));
+        if (exact < split)
+            worst_lux = fmax(worst_lux, err);
+        else
+            worst_rel = fmax(worst_rel, err / exact);
+    }
+    CHECK(sensor_ldrLux(0xFFFF) == sensor_ldrLux(ADC_MAX));
+
+    printf("  LDR    0 .. %4.0f lux: max error %.2f lux\n", split,
+           worst_lux);
+    printf("  LDR %4.0f .. %4d lux: max error %.2f %%\n", split,
+           LDR_LUX_MAX, worst_rel * 100);
+}
+
+int main(void)
+{
+    printf("sensor tables, %d and %d segments:\n", NTC_TABLE_LEN,
+           LDR_TABLE_LEN);
+    test_ntc();
+    test_ldr();
+
+    return check_done("test_sensor");
+}
@@ -0,0 +1,198 @@
+/***************************************************************************//**
+ * @file    test_uart.c
+ * @author  Amrutha Venkatesan
+ * @date    17th October 2026
+ *
+ * @brief   Host test of the UART transmit queue (libs/uart.c)
+ *
+ * A timer signal plays the transmitter: every BYTE_US it raises UCA0TXIFG
+ * and, if the interrupt is enabled, runs uart_TXISR() the way the
+ * USCIAB0TX dispatcher does. A byte written to UCA0TXBUF counts as sent.
+ * The test checks the byte stream for every full-queue policy and counts
+ * the byte times serialPrint() keeps the main loop waiting.
+ ******************************************************************************/
+
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#include "check.h"
+#include "../libs/uart.h"
+#include "../libs/interrupts.h"
+
+#define BYTE_US     50          // one byte on the line
+#define FRAME_LEN   900         // a dashboard refresh, about
+#define SHORT_FRAME "\e[2;1Hshort frame"
+
+static char frame[FRAME_LEN + 1];
+static char line[2 * FRAME_LEN];            // what went out on TXD
+static volatile unsigned int sent;
+static volatile unsigned long byteTimes;    // line clock, one per byte
+static volatile unsigned char paused;       // line stopped, no interrupt
+static volatile unsigned char txLoaded;     // UCA0TXBUF written
+
+static void uart_hook(volatile void *reg)
+{
+    if (reg == &stub_UCA0TXBUF)
+        txLoaded = 1;
+}
+
+// One byte time: the shift register is free again. The signal is blocked
+// while the code under test has GIE cleared.
+static void byte_time(int sig)
+{
+    (void) sig;
+    byteTimes++;
+    if (paused)
+        return;
+
+    stub_IFG2 |= UCA0TXIFG;
+    if (!(stub_IFG2 & stub_IE2 & UCA0TXIFG))
+        return;
+
+    stub_gie = 0;               // cleared on entry, as on the chip
+    txLoaded = 0;
+    uart_TXISR();
+    stub_gie = 1;
+
+    if (txLoaded)
+    {
+        stub_IFG2 &= ~UCA0TXIFG;
+        if (sent < sizeof(line))
+            line[sent++] = stub_UCA0TXBUF;
+    }
+}
+
+static void line_start(void)
+{
+    struct sigaction action;
+    struct itimerval timer = { { 0, BYTE_US }, { 0, BYTE_US } };
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = byte_time;
+    sigaction(SIGALRM, &action, 0);
+    setitimer(ITIMER_REAL, &timer, 0);
+}
+
+static void line_resume(void)
+{
+    paused = 0;
+    serialTxDrain();
+}
+
+static void wait_bytes(unsigned long n)
+{
+    unsigned long until = byteTimes + n;
+
+    while (byteTimes < until)
+        ;
+}
+
+// A frame blocks the caller for all but the last queue full of bytes
+static void test_block(void)
+{
+    unsigned long before;
+    unsigned long stalled;
+    unsigned int stalls;
+
+    serialTxPolicy(TX_POLICY_BLOCK);
+    sent = 0;
+    before = byteTimes;
+    serialPrint(frame);
+    stalled = byteTimes - before;
+    stalls = serialTxStalls();
+    serialTxDrain();
+
+    CHECK(sent == FRAME_LEN);
+    CHECK(memcmp(line, frame, FRAME_LEN) == 0);
+    CHECK(stalled >= FRAME_LEN - TX_BUFFER_SIZE);
+    CHECK(stalls > 0);
+    CHECK(serialError() == 0);
+    printf("block: %d byte frame stalls the main loop for %lu byte times\n",
+           FRAME_LEN, stalled);
+
+    // What fits into the queue returns at once
+    sent = 0;
+    serialPrint(SHORT_FRAME);
+    CHECK(serialTxStalls() == 0);
+    serialTxDrain();
+    CHECK(sent == strlen(SHORT_FRAME));
+    CHECK(memcmp(line, SHORT_FRAME, sent) == 0);
+}
+
+// With the line stopped, only the first queue full goes out
+static void test_drop(void)
+{
+    serialTxPolicy(TX_POLICY_DROP);
+    sent = 0;
+    paused = 1;
+    serialPrint(frame);
+    CHECK(serialTxStalls() == 0);
+    CHECK(serialTxPending() == TX_BUFFER_SIZE - 1);
+    CHECK(serialError() == SERIAL_TX_OVERFLOW);
+    line_resume();
+
+    CHECK(sent == TX_BUFFER_SIZE - 1);
+    CHECK(memcmp(line, frame, TX_BUFFER_SIZE - 1) == 0);
+    printf("drop: %d of %d bytes sent, main loop not stalled\n", sent,
+           FRAME_LEN);
+}
+
+// A frame that lost a byte stays cut until the next one starts
+static void test_truncate(void)
+{
+    serialTxPolicy(TX_POLICY_TRUNCATE);
+    sent = 0;
+    paused = 1;
+    serialFrameStart();
+    serialPrint(frame);
+    line_resume();
+    serialPrint("rest");                    // same frame, dropped
+    serialFrameStart();
+    serialPrint("next");
+    serialTxDrain();
+
+    CHECK(sent == TX_BUFFER_SIZE - 1 + 4);
+    CHECK(memcmp(line, frame, TX_BUFFER_SIZE - 1) == 0);
+    CHECK(memcmp(line + TX_BUFFER_SIZE - 1, "next", 4) == 0);
+    CHECK(serialError() == SERIAL_TX_OVERFLOW);
+    serialTxPolicy(TX_POLICY_BLOCK);
+}
+
+// Nothing passes a reserved byte until it is patched
+static void test_reserve(void)
+{
+    unsigned char slot;
+
+    sent = 0;
+    slot = serialReserve();
+    CHECK(slot != TX_NO_SLOT);
+    serialPrint("abc");
+    wait_bytes(10);
+    CHECK(sent == 0);
+    serialPatch(slot, 'X');
+    serialTxDrain();
+
+    CHECK(sent == 4);
+    CHECK(memcmp(line, "Xabc", 4) == 0);
+}
+
+int main(void)
+{
+    unsigned int i;
+
+    // VT100 text, as disp_value() sends it
+    for (i = 0; i < FRAME_LEN; i++)
+        frame[i] = "\e[12;40HNTC 21.5 C  LDR 230 lux\r\n"[i % 33];
+
+    stub_hook = uart_hook;
+    uart_init();
+    line_start();
+    __enable_interrupt();
+
+    test_block();
+    test_drop();
+    test_truncate();
+    test_reserve();
+
+    return check_done("test_uart");
+}
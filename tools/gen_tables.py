@@ -0,0 +1,244 @@
+#!/usr/bin/env python3
+"""Generate the sensor conversion tables in libs/.
+
+The MSP430 has neither an FPU nor a fast log(), so sensor curves are
+evaluated here and stored as segment tables that the firmware evaluates
+with one multiply and a shift: every segment holds its start value and
+slope in fixed point, a coarse index on the upper ADC code bits finds the
+segment. Segments are made as long as the tolerance allows, so the steep
+ends of a curve get more of them. Edit the parameters below to match the
+board, then run
+
+    tools/gen_tables.py            # rewrite the headers
+    tools/gen_tables.py --check    # check the headers against the parameters
+
+and commit the generated headers with the change. --check exits with 1 if
+a header does not match the parameters. The firmware code itself is
+checked against the curves and tolerances by tests/test_sensor.c, run it
+with "make -C tests".
+"""
+
+import argparse
+import math
+import os
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+# NTC (U_NTC, P1.0 / A0): NTC from the pin to GND, R_FIXED from the pin to
+# VCC. The ADC10 uses VCC as reference, so the code depends on the ratio
+# only: adc = 1024 * R_ntc / (R_ntc + R_FIXED).
+NTC_R25 = 10000.0       # Ohm at 25 degC
+NTC_BETA = 3950.0       # K
+NTC_R_FIXED = 10000.0   # Ohm
+NTC_T_MIN = -40.0       # degC, table is clamped to this range
+NTC_T_MAX = 150.0
+
+# LDR (LDR, P1.3 / A3): LDR from the pin to VCC, R_FIXED from the pin to
+# GND, so the code rises with the light. Photo resistor model
+# R = R10 * (lux / 10)^-GAMMA, GL55xx style values.
+LDR_R10 = 10000.0       # Ohm at 10 lux
+LDR_GAMMA = 0.7
+LDR_R_FIXED = 10000.0   # Ohm
+LDR_LUX_MAX = 2000      # lux, the LDR saturates above, table clamped
+
+# Largest error allowed for any ADC code. The NTC table gives tenths of
+# degC, the LDR table whole lux, hence the absolute floor.
+NTC_TOLERANCE = 0.2         # degC, within NTC_T_MIN .. NTC_T_MAX
+LDR_TOLERANCE = 0.01        # relative
+LDR_TOLERANCE_LUX = 0.6     # lux, at least
+
+ADC_MAX = 1023
+INT_MAX = 32767
+INDEX_SHIFT = 4     # one index entry per 16 ADC codes
+MAX_SHIFT = 8       # fraction bits tried for values and slopes
+
+
+def ntc_celsius(adc):
+    """Exact temperature for an ADC code (float, may be out of range)."""
+    if adc <= 0:
+        return NTC_T_MAX
+    if adc >= 1024:
+        return NTC_T_MIN
+    r = NTC_R_FIXED * adc / (1024.0 - adc)
+    t = 1.0 / (1.0 / 298.15 + math.log(r / NTC_R25) / NTC_BETA) - 273.15
+    return min(max(t, NTC_T_MIN), NTC_T_MAX)
+
+
+def ldr_lux(adc):
+    """Exact illuminance for an ADC code (float, clamped)."""
+    if adc <= 0:
+        return 0.0
+    if adc >= 1024:
+        return float(LDR_LUX_MAX)
+    r = LDR_R_FIXED * (1024.0 - adc) / adc
+    return min(10.0 * (r / LDR_R10) ** (-1.0 / LDR_GAMMA), LDR_LUX_MAX)
+
+
+def evaluate(table, adc):
+    """Same integer math as sensor_interpolate()."""
+    xs, ys, slopes, index, shift = table
+    seg = index[adc >> INDEX_SHIFT]
+    while adc >= xs[seg + 1]:
+        seg += 1
+    # >> floors negative values, like the arithmetic shift of the MSP430
+    return (ys[seg] + slopes[seg] * (adc - xs[seg]) + ((1 << shift) >> 1)) >> shift
+
+
+def ntc_ok(adc, value):
+    exact = ntc_celsius(adc)
+    # The clamped ends are not meant to be exact
+    if not NTC_T_MIN < exact < NTC_T_MAX:
+        return True
+    return abs(value / 10.0 - exact) <= NTC_TOLERANCE
+
+
+def ldr_ok(adc, value):
+    exact = ldr_lux(adc)
+    return abs(value - exact) <= max(LDR_TOLERANCE_LUX, LDR_TOLERANCE * exact)
+
+
+def fit_shift(curve, scale, ok, shift):
+    """Segments over ADC codes 0 .. ADC_MAX for <curve> times <scale> with
+    <shift> fraction bits, or None if the values do not fit into an int. Each segment is made as
+    long as every code on it passes <ok>."""
+    one = 1 << shift
+
+    def point(adc):
+        return int(round(curve(adc) * scale * one))
+
+    xs, ys, slopes = [], [], []
+    x0 = 0
+    while x0 <= ADC_MAX:
+        best = None
+        for x1 in range(x0 + 1, ADC_MAX + 2):
+            y0 = point(x0)
+            slope = int(round(float(point(x1) - y0) / (x1 - x0)))
+            # The sum in sensor_interpolate() is an int
+            if abs(y0) + abs(slope) * (x1 - 1 - x0) + (one >> 1) > INT_MAX:
+                break
+            table = ([x0, x1], [y0], [slope], [0] * ((ADC_MAX >> INDEX_SHIFT) + 1),
+                     shift)
+            if not all(ok(adc, evaluate(table, adc))
+                       for adc in range(x0, x1)):
+                break
+            best = (x1, y0, slope)
+        if best is None:
+            return None
+        xs.append(x0)
+        ys.append(best[1])
+        slopes.append(best[2])
+        x0 = best[0]
+    xs.append(ADC_MAX + 1)
+    index = [max(i for i in range(len(ys)) if xs[i] <= (j << INDEX_SHIFT))
+             for j in range((ADC_MAX >> INDEX_SHIFT) + 1)]
+    return xs, ys, slopes, index, shift
+
+
+def fit(curve, scale, ok):
+    """The table with the fewest segments, the finer slopes if equal."""
+    best = None
+    for shift in range(MAX_SHIFT + 1):
+        table = fit_shift(curve, scale, ok, shift)
+        if table and (best is None or len(table[1]) <= len(best[1])):
+            best = table
+    return best
+
+
+def c_array(name, ctype, values, per_line=8):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append("    " + ", ".join("%d" % v for v in values[i:i + per_line]))
+    return "const %s %s[%d] =\n{\n%s\n};\n" % (ctype, name, len(values),
+                                              ",\n".join(lines))
+
+
+def header_text(name, guard, brief, body):
+    return ("/***************************************************************************//**\n"
+            " * @file    %s\n"
+            " *\n"
+            " * @brief   %s\n"
+            " *\n"
+            " * Generated by tools/gen_tables.py, do not edit.\n"
+            " ******************************************************************************/\n"
+            "\n"
+            "#ifndef %s\n"
+            "#define %s\n"
+            "\n"
+            "%s"
+            "\n"
+            "#endif /* %s */\n") % (name, brief, guard, guard, body, guard)
+
+
+def table_body(prefix, comment, params, table):
+    xs, ys, slopes, index, shift = table
+    body = comment
+    body += "\n// Curve and tolerance the table was generated for\n"
+    for name, value in params:
+        body += "#define %-22s %r\n" % ("%s_%s" % (prefix, name), value)
+    body += "\n"
+    body += "#define %s_TABLE_LEN %d\n" % (prefix, len(ys))
+    body += "#define %s_TABLE_SHIFT %d\n" % (prefix, shift)
+    body += "#define %s_INDEX_SHIFT %d\n\n" % (prefix, INDEX_SHIFT)
+    body += c_array("%s_TABLE_X" % prefix, "unsigned int", xs)
+    body += "\n"
+    body += c_array("%s_TABLE_Y" % prefix, "int", ys)
+    body += "\n"
+    body += c_array("%s_TABLE_SLOPE" % prefix, "int", slopes)
+    body += "\n"
+    body += c_array("%s_TABLE_INDEX" % prefix, "unsigned char", index, 16)
+    return body
+
+
+def ntc_header():
+    comment = ("// NTC %.0f Ohm / B %.0f K against %.0f Ohm, clamped to %.0f .. %.0f degC.\n"
+               "// Segments start at ADC code X with Y tenths of degC and rise by\n"
+               "// SLOPE per code, both with TABLE_SHIFT fraction bits. INDEX holds\n"
+               "// the segment of every 1 << INDEX_SHIFT codes.\n"
+               % (NTC_R25, NTC_BETA, NTC_R_FIXED, NTC_T_MIN, NTC_T_MAX))
+    params = [("R25", NTC_R25), ("BETA", NTC_BETA), ("R_FIXED", NTC_R_FIXED),
+              ("T_MIN", NTC_T_MIN), ("T_MAX", NTC_T_MAX),
+              ("TOLERANCE", NTC_TOLERANCE)]
+    return ("ntc_table.h", "LIBS_NTC_TABLE_H_", "NTC temperature table",
+            table_body("NTC", comment, params, fit(ntc_celsius, 10, ntc_ok)))
+
+
+def ldr_header():
+    comment = ("// LDR %.0f Ohm at 10 lux / gamma %.2f against %.0f Ohm, clamped to\n"
+               "// %d lux. Segments start at ADC code X with Y lux and rise by SLOPE\n"
+               "// per code, both with TABLE_SHIFT fraction bits. INDEX holds the\n"
+               "// segment of every 1 << INDEX_SHIFT codes.\n"
+               % (LDR_R10, LDR_GAMMA, LDR_R_FIXED, LDR_LUX_MAX))
+    params = [("R10", LDR_R10), ("GAMMA", LDR_GAMMA),
+              ("R_FIXED", LDR_R_FIXED), ("LUX_MAX", LDR_LUX_MAX),
+              ("TOLERANCE", LDR_TOLERANCE),
+              ("TOLERANCE_LUX", LDR_TOLERANCE_LUX)]
+    return ("ldr_table.h", "LIBS_LDR_TABLE_H_", "LDR illuminance table",
+            table_body("LDR", comment, params, fit(ldr_lux, 1, ldr_ok)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--check", action="store_true",
+                        help="only check that the headers are up to date")
+    args = parser.parse_args()
+
+    good = True
+    for name, guard, brief, body in (ntc_header(), ldr_header()):
+        path = os.path.join(ROOT, "libs", name)
+        text = header_text(name, guard, brief, body)
+        if args.check:
+            # newline="" keeps the CRLF line endings for the comparison
+            with open(path, newline="") as f:
+                same = f.read() == text.replace("\n", "\r\n")
+            print("%s: %s" % (name, "ok" if same else "does not match the parameters"))
+            good = good and same
+        else:
+            # The sources use CRLF line endings
+            with open(path, "w", newline="\r\n") as f:
+                f.write(text)
+    return 0 if good else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
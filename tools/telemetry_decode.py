@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Decode a captured binary telemetry stream into CSV.
+
+The dashboard sends one COBS framed, CRC protected record per acquisition
+cycle, plus one per accelerometer or light event, after the console command
+"telemetry binary" (layout in libs/telemetry.h). Capture the serial port to a file, e.g.
+
+    stty -F /dev/ttyACM0 9600 raw
+    cat /dev/ttyACM0 > capture.bin
+
+and convert it with
+
+    tools/telemetry_decode.py capture.bin > samples.csv
+
+Records with a bad CRC or length (text output in between, line noise) are
+skipped and counted on stderr.
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+TELEMETRY_SAMPLE = 0x01
+TELEMETRY_EVENT = 0x02
+
+# type, seq, tick, range, acc x/y/z, joy x/y, pot, ldr, ntc, pb,
+# range confidence and count
+SAMPLE = struct.Struct("<BHIh3hBBHHHBBB")
+# type, seq, tick, event, src
+EVENT = struct.Struct("<BHIBB")
+
+# MMA_EVENT_* in libs/mma.h, SENSOR_EVENT_* in libs/sensor.h
+EVENT_NAMES = {0x04: "motion", 0x08: "tap", 0x10: "orientation",
+               0x20: "transient", 0x40: "light"}
+
+TICK_US = 8192     # 1 MHz clock profile, see libs/clock.h
+
+FIELDS = ["seq", "tick", "time_s", "range_mm", "acc_x", "acc_y", "acc_z",
+          "joy_x", "joy_y", "pot", "ldr", "ntc", "pb", "range_conf",
+          "range_count", "event", "src"]
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, as telemetry_crc16()."""
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(frame):
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame):
+            return None
+        out += frame[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+def records(stream):
+    """Yield decoded, CRC checked records; count the rejected ones."""
+    rejected = 0
+    for frame in stream.split(b"\x00"):
+        if not frame:
+            continue
+        data = cobs_decode(frame)
+        if data is None or len(data) < 3:
+            rejected += 1
+            continue
+        body, crc = data[:-2], struct.unpack("<H", data[-2:])[0]
+        if crc16(body) != crc:
+            rejected += 1
+            continue
+        yield body
+    if rejected:
+        print("%d frame(s) rejected" % rejected, file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", nargs="?", help="capture file (default stdin)")
+    parser.add_argument("--tick-us", type=float, default=TICK_US,
+                        help="length of one tick in us, TICK_US in libs/clock.h "
+                             "(default %(default)s)")
+    args = parser.parse_args()
+
+    if args.capture:
+        with open(args.capture, "rb") as f:
+            stream = f.read()
+    else:
+        stream = sys.stdin.buffer.read()
+
+    writer = csv.writer(sys.stdout)
+    writer.writerow(FIELDS)
+    for body in records(stream):
+        if body[0] == TELEMETRY_SAMPLE and len(body) == SAMPLE.size:
+            (_, seq, tick, rng, ax, ay, az,
+             jx, jy, pot, ldr, ntc, pb, conf, count) = SAMPLE.unpack(body)
+            writer.writerow([seq, tick, "%.3f" % (tick * args.tick_us / 1e6),
+                             rng, "%.2f" % (ax / 100.0), "%.2f" % (ay / 100.0),
+                             "%.2f" % (az / 100.0), jx, jy, pot, ldr, ntc, pb,
+                             conf, count, "", ""])
+        elif body[0] == TELEMETRY_EVENT and len(body) == EVENT.size:
+            # Events share the sequence, so gaps stay visible; the sample
+            # columns stay empty
+            _, seq, tick, event, src = EVENT.unpack(body)
+            writer.writerow([seq, tick, "%.3f" % (tick * args.tick_us / 1e6)]
+                            + [""] * 12
+                            + [EVENT_NAMES.get(event, "0x%02x" % event),
+                               "0x%02x" % src])
+
+
+if __name__ == "__main__":
+    main()